@@ -0,0 +1,95 @@
+#include <benchmark/benchmark.h>
+#include <CowPtr.h>
+
+#include <array>
+#include <memory>
+#include <random>
+#include <vector>
+
+// A 64 KiB configuration blob owned by a writer and snapshotted by readers.
+// state.range(0) percent of the operations write one field, state.range(1)
+// percent hand a snapshot to one of the readers, and the rest read a field.
+//
+// The defensive baseline copies the blob before every write, as callers do
+// when they cannot tell whether anyone else holds it. CowPtr copies only on
+// the first write after a snapshot. The copies counter is per operation;
+// every copy is also one blob allocation plus one holder.
+
+constexpr int kBlobInts = 16 * 1024;
+constexpr int kReaders = 8;
+constexpr int kOps = 1024;
+
+struct Config {
+    Config() : values(kBlobInts, 0) {}
+
+    Config(const Config& other) : values(other.values) {
+        ++copies;
+    }
+
+    std::vector<int> values;
+    static inline long copies = 0;
+};
+
+enum class Op { Read, Write, Snapshot };
+
+static std::vector<Op> MakeSchedule(const benchmark::State& state) {
+    const auto write_percent = static_cast<int>(state.range(0));
+    const auto snapshot_percent = static_cast<int>(state.range(1));
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::vector<Op> schedule(kOps);
+    for (auto& op : schedule) {
+        const int roll = percent(random);
+        op = roll < write_percent ? Op::Write : roll < write_percent + snapshot_percent ? Op::Snapshot : Op::Read;
+    }
+    return schedule;
+}
+
+static void BM_ConfigUpdates_Defensive(benchmark::State& state) {
+    const auto schedule = MakeSchedule(state);
+    auto current = std::make_shared<const Config>();
+    std::array<std::shared_ptr<const Config>, kReaders> snapshots;
+    Config::copies = 0;
+    for (auto _ : state) {
+        for (int i = 0; i < kOps; ++i) {
+            if (schedule[i] == Op::Write) {
+                auto next = std::make_shared<Config>(*current);
+                next->values[i] = i;
+                current = std::move(next);
+            } else if (schedule[i] == Op::Snapshot) {
+                snapshots[i % kReaders] = current;
+            } else {
+                benchmark::DoNotOptimize(current->values[i]);
+            }
+        }
+    }
+    state.counters["copies"] = benchmark::Counter(static_cast<double>(Config::copies) / kOps,
+                                                  benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations() * kOps);
+}
+
+static void BM_ConfigUpdates_CowPtr(benchmark::State& state) {
+    const auto schedule = MakeSchedule(state);
+    CowPtr<Config> current;
+    std::array<CowPtr<Config>, kReaders> snapshots;
+    Config::copies = 0;
+    for (auto _ : state) {
+        for (int i = 0; i < kOps; ++i) {
+            if (schedule[i] == Op::Write) {
+                current.Write().values[i] = i;
+            } else if (schedule[i] == Op::Snapshot) {
+                snapshots[i % kReaders] = current;
+            } else {
+                benchmark::DoNotOptimize(current->values[i]);
+            }
+        }
+    }
+    state.counters["copies"] = benchmark::Counter(static_cast<double>(Config::copies) / kOps,
+                                                  benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations() * kOps);
+}
+
+BENCHMARK(BM_ConfigUpdates_Defensive)->Args({5, 1})->Args({20, 2})->Args({50, 10});
+BENCHMARK(BM_ConfigUpdates_CowPtr)->Args({5, 1})->Args({20, 2})->Args({50, 10});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,103 @@
+#include <benchmark/benchmark.h>
+#include <GraphSerializer.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
+// Saving, opening and loading a DAG of 2^20 nodes. The graph is a complete
+// binary tree where every node also points at one grandchild, so about half
+// of the objects are reached twice. Open only maps and validates the file;
+// LoadAll rebuilds the whole graph and LoadSubgraph a single leaf.
+
+struct GraphNode : RefCounter {
+    void Serialize(GraphWriter& out) const {
+        out.Value(value);
+        out.Value(static_cast<std::uint32_t>(edges.size()));
+        for (const auto& edge : edges) {
+            out.Reference(edge);
+        }
+    }
+
+    void Deserialize(GraphReader& in) {
+        in.Value(value);
+        std::uint32_t count = 0;
+        in.Value(count);
+        edges.resize(count);
+        for (auto& edge : edges) {
+            in.Reference(edge);
+        }
+    }
+
+    std::int64_t value = 0;
+    std::vector<IntrusivePtr<GraphNode>> edges;
+};
+
+static IntrusivePtr<GraphNode> BuildGraph(std::size_t count) {
+    std::vector<IntrusivePtr<GraphNode>> nodes(count);
+    for (std::size_t i = count; i-- > 0;) {
+        nodes[i] = make_intrusive<GraphNode>();
+        nodes[i]->value = static_cast<std::int64_t>(i);
+        for (std::size_t child : {2 * i + 1, 2 * i + 2, 4 * i + 3}) {
+            if (child < count) {
+                nodes[i]->edges.push_back(nodes[child]);
+            }
+        }
+    }
+    return nodes[0];
+}
+
+static std::string GraphPath() {
+    return (std::filesystem::temp_directory_path() / "graph_serializer_benchmark.bin").string();
+}
+
+static void BM_Save(benchmark::State& state) {
+    const auto root = BuildGraph(state.range(0));
+    for (auto _ : state) {
+        GraphWriter writer;
+        writer.Write(root);
+        writer.Save(GraphPath());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_Open(benchmark::State& state) {
+    GraphWriter writer;
+    writer.Write(BuildGraph(state.range(0)));
+    writer.Save(GraphPath());
+    for (auto _ : state) {
+        GraphReader reader = GraphReader::Open(GraphPath());
+        benchmark::DoNotOptimize(reader.ObjectCount());
+    }
+    std::remove(GraphPath().c_str());
+}
+
+static void BM_LoadAll(benchmark::State& state) {
+    GraphWriter writer;
+    writer.Write(BuildGraph(state.range(0)));
+    writer.Save(GraphPath());
+    for (auto _ : state) {
+        GraphReader reader = GraphReader::Open(GraphPath());
+        benchmark::DoNotOptimize(reader.Load<GraphNode>(0));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    std::remove(GraphPath().c_str());
+}
+
+static void BM_LoadSubgraph(benchmark::State& state) {
+    GraphWriter writer;
+    writer.Write(BuildGraph(state.range(0)));
+    writer.Save(GraphPath());
+    for (auto _ : state) {
+        GraphReader reader = GraphReader::Open(GraphPath());
+        benchmark::DoNotOptimize(reader.Load<GraphNode>(reader.ObjectCount() - 1));
+    }
+    std::remove(GraphPath().c_str());
+}
+
+BENCHMARK(BM_Save)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Open)->Arg(1 << 20)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_LoadAll)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LoadSubgraph)->Arg(1 << 20)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,87 @@
+#include <benchmark/benchmark.h>
+#include <InternTable.h>
+
+#include <string>
+#include <vector>
+
+// Many small immutable objects with few distinct values. Interning returns the
+// existing object for a repeated value instead of allocating a new one; the
+// objects counter shows how many distinct allocations stay alive.
+
+class Symbol : public RefCounter {
+public:
+    explicit Symbol(std::string name) : name(std::move(name)) {}
+
+    bool operator==(const Symbol& other) const {
+        return name == other.name;
+    }
+
+    std::string name;
+};
+
+struct SymbolHash {
+    std::size_t operator()(const Symbol& symbol) const {
+        return std::hash<std::string>{}(symbol.name);
+    }
+};
+
+static std::vector<std::string> MakeNames(int count, int distinct) {
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        names.push_back("identifier_" + std::to_string(i % distinct));
+    }
+    return names;
+}
+
+static void BM_Symbols_MakeIntrusive(benchmark::State& state) {
+    const auto names = MakeNames(1 << 18, static_cast<int>(state.range(0)));
+    std::vector<IntrusivePtr<Symbol>> symbols(names.size());
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            symbols[i] = make_intrusive<Symbol>(names[i]);
+        }
+    }
+    state.counters["objects"] = static_cast<double>(symbols.size());
+    state.SetItemsProcessed(state.iterations() * names.size());
+}
+
+static void BM_Symbols_Interned(benchmark::State& state) {
+    const auto names = MakeNames(1 << 18, static_cast<int>(state.range(0)));
+    InternTable<Symbol, SymbolHash>& table = InternTable<Symbol, SymbolHash>::Instance();
+    std::vector<IntrusivePtr<Symbol>> symbols(names.size());
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            symbols[i] = table.Intern(Symbol(names[i]));
+        }
+    }
+    state.counters["objects"] = static_cast<double>(table.size());
+    state.SetItemsProcessed(state.iterations() * names.size());
+    symbols.clear();
+}
+
+// Hit path from several threads: every value is already interned and held.
+static void BM_InternHit(benchmark::State& state) {
+    static InternTable<Symbol, SymbolHash> table;
+    static std::vector<IntrusivePtr<Symbol>> held;
+    static const auto names = MakeNames(1024, 1024);
+    if (state.thread_index() == 0) {
+        for (const auto& name : names) {
+            held.push_back(table.Intern(Symbol(name)));
+        }
+    }
+    std::size_t i = static_cast<std::size_t>(state.thread_index()) * 131;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.Intern(Symbol(names[i++ % names.size()])));
+    }
+    if (state.thread_index() == 0) {
+        held.clear();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_Symbols_MakeIntrusive)->Arg(1 << 8)->Arg(1 << 14);
+BENCHMARK(BM_Symbols_Interned)->Arg(1 << 8)->Arg(1 << 14);
+BENCHMARK(BM_InternHit)->ThreadRange(1, 8);
+
+BENCHMARK_MAIN();
@@ -46,6 +46,58 @@ static void BM_Copy_Shared(benchmark::State& state) {
     }
 }
 
+static void BM_WeakCreate_Intrusive(benchmark::State& state) {
+    auto p = make_intrusive<TestClass>();
+    for (auto _ : state) {
+        IntrusiveWeakPtr<TestClass> weak(p);
+        benchmark::DoNotOptimize(weak);
+    }
+}
+
+static void BM_WeakCreate_Shared(benchmark::State& state) {
+    auto p = std::make_shared<TestClass2>();
+    for (auto _ : state) {
+        std::weak_ptr<TestClass2> weak(p);
+        benchmark::DoNotOptimize(weak);
+    }
+}
+
+static void BM_WeakCopy_Intrusive(benchmark::State& state) {
+    auto p = make_intrusive<TestClass>();
+    IntrusiveWeakPtr<TestClass> weak(p);
+    for (auto _ : state) {
+        IntrusiveWeakPtr<TestClass> copy = weak;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+static void BM_WeakCopy_Shared(benchmark::State& state) {
+    auto p = std::make_shared<TestClass2>();
+    std::weak_ptr<TestClass2> weak(p);
+    for (auto _ : state) {
+        std::weak_ptr<TestClass2> copy = weak;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+static void BM_WeakUpgrade_Intrusive(benchmark::State& state) {
+    auto p = make_intrusive<TestClass>();
+    IntrusiveWeakPtr<TestClass> weak(p);
+    for (auto _ : state) {
+        auto strong = weak.upgrade();
+        benchmark::DoNotOptimize(strong);
+    }
+}
+
+static void BM_WeakUpgrade_Shared(benchmark::State& state) {
+    auto p = std::make_shared<TestClass2>();
+    std::weak_ptr<TestClass2> weak(p);
+    for (auto _ : state) {
+        auto strong = weak.lock();
+        benchmark::DoNotOptimize(strong);
+    }
+}
+
 static void BM_Dereference_Intrusive(benchmark::State& state) {
     IntrusivePtr<TestClass> p = make_intrusive<TestClass>();
     for (auto _ : state) {
@@ -94,6 +146,15 @@ BENCHMARK(BM_Dereference_Shared);
 BENCHMARK(BM_Copy_Intrusive);
 BENCHMARK(BM_Copy_Shared);
 
+BENCHMARK(BM_WeakCreate_Intrusive);
+BENCHMARK(BM_WeakCreate_Shared);
+
+BENCHMARK(BM_WeakCopy_Intrusive);
+BENCHMARK(BM_WeakCopy_Shared);
+
+BENCHMARK(BM_WeakUpgrade_Intrusive);
+BENCHMARK(BM_WeakUpgrade_Shared);
+
 BENCHMARK(BM_CreateDestroy_Intrusive);
 BENCHMARK(BM_CreateDestroy_Shared);
 
@@ -0,0 +1,144 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <x86intrin.h>
+#endif
+
+
+// Timestamp source for per-operation timings. On x86-64 this is the TSC,
+// fenced so the read is not reordered with the measured operation; elsewhere
+// it falls back to steady_clock nanoseconds.
+inline std::uint64_t ReadTimestamp()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    _mm_lfence();
+    std::uint64_t tsc = __rdtsc();
+    _mm_lfence();
+    return tsc;
+#else
+    return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// Nanoseconds per ReadTimestamp() tick, measured once against steady_clock.
+inline double TimestampNanosecondsPerTick()
+{
+    static const double ratio = []
+    {
+        auto wall_begin = std::chrono::steady_clock::now();
+        std::uint64_t tick_begin = ReadTimestamp();
+        while (std::chrono::steady_clock::now() - wall_begin < std::chrono::milliseconds(20))
+        {
+        }
+        auto wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - wall_begin).count();
+        std::uint64_t ticks = ReadTimestamp() - tick_begin;
+        return ticks == 0 ? 1.0 : static_cast<double>(wall_ns) / static_cast<double>(ticks);
+    }();
+    return ratio;
+}
+
+
+// HDR-style log-linear histogram: every power of two is split into 32 linear
+// sub-buckets, so any recorded value is reported with ~3% relative error while
+// the whole 64-bit range fits in a fixed 15 KiB array.
+class LatencyHistogram
+{
+public:
+    void Record(std::uint64_t ticks)
+    {
+        ++counts_[BucketIndex(ticks)];
+        ++total_;
+        if (ticks > max_)
+        {
+            max_ = ticks;
+        }
+    }
+
+    // Upper bound (in ticks) of the bucket holding the given percentile.
+    [[nodiscard]] std::uint64_t Percentile(double percentile) const
+    {
+        if (total_ == 0)
+        {
+            return 0;
+        }
+        auto rank = static_cast<std::uint64_t>(percentile / 100.0 * static_cast<double>(total_));
+        if (rank >= total_)
+        {
+            rank = total_ - 1;
+        }
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < counts_.size(); ++i)
+        {
+            seen += counts_[i];
+            if (seen > rank)
+            {
+                return BucketUpperBound(i) < max_ ? BucketUpperBound(i) : max_;
+            }
+        }
+        return max_;
+    }
+
+    [[nodiscard]] std::uint64_t count() const
+    {
+        return total_;
+    }
+
+    [[nodiscard]] std::uint64_t max() const
+    {
+        return max_;
+    }
+
+    // Publishes p50/p90/p99/p99.9/max in nanoseconds as benchmark counters.
+    void Report(benchmark::State& state, const std::string& prefix = "") const
+    {
+        const double ns = TimestampNanosecondsPerTick();
+        state.counters[prefix + "p50_ns"] = static_cast<double>(Percentile(50.0)) * ns;
+        state.counters[prefix + "p90_ns"] = static_cast<double>(Percentile(90.0)) * ns;
+        state.counters[prefix + "p99_ns"] = static_cast<double>(Percentile(99.0)) * ns;
+        state.counters[prefix + "p999_ns"] = static_cast<double>(Percentile(99.9)) * ns;
+        state.counters[prefix + "max_ns"] = static_cast<double>(max_) * ns;
+    }
+
+private:
+    static constexpr int kSubBucketBits = 5;
+    static constexpr std::uint64_t kSubBuckets = 1ull << kSubBucketBits;
+
+    static std::size_t BucketIndex(std::uint64_t value)
+    {
+        if (value < kSubBuckets)
+        {
+            return static_cast<std::size_t>(value);
+        }
+        const int exponent = std::bit_width(value) - 1;
+        const std::uint64_t sub = (value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+        return static_cast<std::size_t>((exponent - kSubBucketBits + 1) * kSubBuckets + sub);
+    }
+
+    static std::uint64_t BucketUpperBound(std::size_t index)
+    {
+        if (index < kSubBuckets)
+        {
+            return index;
+        }
+        const int exponent = static_cast<int>(index / kSubBuckets) + kSubBucketBits - 1;
+        const std::uint64_t sub = index % kSubBuckets;
+        const int shift = exponent - kSubBucketBits;
+        return (((kSubBuckets | sub) + 1) << shift) - 1;
+    }
+
+    std::array<std::uint64_t, (64 - kSubBucketBits + 1) * kSubBuckets> counts_{};
+    std::uint64_t total_ = 0;
+    std::uint64_t max_ = 0;
+};
+
+#endif //LATENCYHISTOGRAM_H
@@ -0,0 +1,216 @@
+#include <benchmark/benchmark.h>
+#include <IntrusivePtr.h>
+#include <SharedPointer.h>
+#include "LatencyHistogram.h"
+
+#include <memory>
+#include <vector>
+
+// Latency-distribution benchmarks. Every operation is timed on its own and
+// recorded in a LatencyHistogram, which publishes p50..p99.9 and max counters:
+// the means reported by Google Benchmark hide the rare stalls we care about.
+
+constexpr int kBatch = 4096;
+
+class IntrusiveNode : public RefCounter
+{
+public:
+    explicit IntrusiveNode(int value = 0) : value(value) {}
+    int value = 0;
+    IntrusivePtr<IntrusiveNode> next;
+};
+
+class PlainNode
+{
+public:
+    explicit PlainNode(int value = 0) : value(value) {}
+    int value = 0;
+    SharedPointer<PlainNode> next;
+};
+
+class StdNode
+{
+public:
+    explicit StdNode(int value = 0) : value(value) {}
+    int value = 0;
+    std::shared_ptr<StdNode> next;
+};
+
+
+// COPY
+
+static void BM_CopyLatency_Intrusive(benchmark::State& state) {
+    LatencyHistogram histogram;
+    auto p = make_intrusive<IntrusiveNode>();
+    std::vector<IntrusivePtr<IntrusiveNode>> copies(kBatch);
+    for (auto _ : state) {
+        for (auto& copy : copies) {
+            std::uint64_t begin = ReadTimestamp();
+            copy = p;
+            histogram.Record(ReadTimestamp() - begin);
+        }
+        for (auto& copy : copies) {
+            copy.reset();
+        }
+    }
+    histogram.Report(state);
+}
+
+static void BM_CopyLatency_SharedPointer(benchmark::State& state) {
+    LatencyHistogram histogram;
+    SharedPointer<PlainNode> p(new PlainNode());
+    std::vector<SharedPointer<PlainNode>> copies;
+    copies.reserve(kBatch);
+    for (auto _ : state) {
+        for (int i = 0; i < kBatch; ++i) {
+            std::uint64_t begin = ReadTimestamp();
+            copies.emplace_back(p);
+            histogram.Record(ReadTimestamp() - begin);
+        }
+        for (auto& copy : copies) {
+            copy.reset();
+        }
+        copies.clear();
+    }
+    histogram.Report(state);
+}
+
+static void BM_CopyLatency_Shared(benchmark::State& state) {
+    LatencyHistogram histogram;
+    auto p = std::make_shared<StdNode>();
+    std::vector<std::shared_ptr<StdNode>> copies(kBatch);
+    for (auto _ : state) {
+        for (auto& copy : copies) {
+            std::uint64_t begin = ReadTimestamp();
+            copy = p;
+            histogram.Record(ReadTimestamp() - begin);
+        }
+        for (auto& copy : copies) {
+            copy.reset();
+        }
+    }
+    histogram.Report(state);
+}
+
+
+// FINAL RELEASE
+// Each timed operation drops the last reference to a chain of state.range(0)
+// nodes, so the measured time includes the whole cascaded destruction.
+
+template <class Ptr, class MakeNode>
+static std::vector<Ptr> BuildChains(int chain_count, int chain_length, MakeNode make_node) {
+    std::vector<Ptr> heads;
+    heads.reserve(chain_count);
+    for (int c = 0; c < chain_count; ++c) {
+        Ptr head = make_node(0);
+        for (int i = 1; i < chain_length; ++i) {
+            Ptr node = make_node(i);
+            node->next = head;
+            head = node;
+        }
+        heads.push_back(head);
+    }
+    return heads;
+}
+
+static void BM_FinalReleaseLatency_Intrusive(benchmark::State& state) {
+    LatencyHistogram histogram;
+    const int length = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto heads = BuildChains<IntrusivePtr<IntrusiveNode>>(kBatch / length + 1, length,
+            [](int i) { return make_intrusive<IntrusiveNode>(i); });
+        state.ResumeTiming();
+        for (auto& head : heads) {
+            std::uint64_t begin = ReadTimestamp();
+            head.reset();
+            histogram.Record(ReadTimestamp() - begin);
+        }
+    }
+    histogram.Report(state);
+}
+
+static void BM_FinalReleaseLatency_SharedPointer(benchmark::State& state) {
+    LatencyHistogram histogram;
+    const int length = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto heads = BuildChains<SharedPointer<PlainNode>>(kBatch / length + 1, length,
+            [](int i) { return SharedPointer<PlainNode>(new PlainNode(i)); });
+        state.ResumeTiming();
+        for (auto& head : heads) {
+            std::uint64_t begin = ReadTimestamp();
+            head.reset();
+            histogram.Record(ReadTimestamp() - begin);
+        }
+    }
+    histogram.Report(state);
+}
+
+static void BM_FinalReleaseLatency_Shared(benchmark::State& state) {
+    LatencyHistogram histogram;
+    const int length = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto heads = BuildChains<std::shared_ptr<StdNode>>(kBatch / length + 1, length,
+            [](int i) { return std::make_shared<StdNode>(i); });
+        state.ResumeTiming();
+        for (auto& head : heads) {
+            std::uint64_t begin = ReadTimestamp();
+            head.reset();
+            histogram.Record(ReadTimestamp() - begin);
+        }
+    }
+    histogram.Report(state);
+}
+
+
+// REGISTRY REHASH
+// Every SharedPointer(Type*) inserts into ExternalRefCounter::ref_map. Growing
+// the map past its load factor rehashes the whole table inside one constructor;
+// those insertions are recorded separately so the stall is visible on its own.
+
+static void BM_AdoptLatency_SharedPointer(benchmark::State& state) {
+    LatencyHistogram all;
+    LatencyHistogram rehashes;
+    const int live = static_cast<int>(state.range(0));
+    ExternalRefCounter& registry = ExternalRefCounter::Instance();
+    for (auto _ : state) {
+        state.PauseTiming();
+        // Shrink the table left over from earlier runs so it has to grow again.
+        registry.ref_map.rehash(0);
+        std::vector<SharedPointer<int>> pointers;
+        pointers.reserve(live);
+        state.ResumeTiming();
+        for (int i = 0; i < live; ++i) {
+            auto* value = new int(i);
+            std::size_t buckets = registry.ref_map.bucket_count();
+            std::uint64_t begin = ReadTimestamp();
+            pointers.emplace_back(value);
+            std::uint64_t elapsed = ReadTimestamp() - begin;
+            all.Record(elapsed);
+            if (registry.ref_map.bucket_count() != buckets) {
+                rehashes.Record(elapsed);
+            }
+        }
+        state.PauseTiming();
+        pointers.clear();
+        state.ResumeTiming();
+    }
+    all.Report(state);
+    rehashes.Report(state, "rehash_");
+    state.counters["rehashes"] = static_cast<double>(rehashes.count());
+}
+
+
+BENCHMARK(BM_CopyLatency_Intrusive);
+BENCHMARK(BM_CopyLatency_SharedPointer);
+BENCHMARK(BM_CopyLatency_Shared);
+
+BENCHMARK(BM_FinalReleaseLatency_Intrusive)->Arg(1)->Arg(64)->Arg(4096);
+BENCHMARK(BM_FinalReleaseLatency_SharedPointer)->Arg(1)->Arg(64)->Arg(4096);
+BENCHMARK(BM_FinalReleaseLatency_Shared)->Arg(1)->Arg(64)->Arg(4096);
+
+BENCHMARK(BM_AdoptLatency_SharedPointer)->Arg(1 << 12)->Arg(1 << 16);
+
+BENCHMARK_MAIN();
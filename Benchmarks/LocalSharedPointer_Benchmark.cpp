@@ -0,0 +1,39 @@
+#include <benchmark/benchmark.h>
+#include <LocalSharedPointer.h>
+#include <memory>
+
+// Single-thread copy loop: the cost of one copy plus one release.
+
+struct Payload {
+    int value = 0;
+};
+
+static void BM_Copy_LocalSharedPointer(benchmark::State& state) {
+    LocalSharedPointer<Payload> p = MakeLocalShared<Payload>();
+    for (auto _ : state) {
+        LocalSharedPointer<Payload> copy = p;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+static void BM_Copy_SharedPointer(benchmark::State& state) {
+    SharedPointer<Payload> p = AllocateShared<Payload>(std::allocator<Payload>());
+    for (auto _ : state) {
+        SharedPointer<Payload> copy = p;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+static void BM_Copy_StdShared(benchmark::State& state) {
+    std::shared_ptr<Payload> p = std::make_shared<Payload>();
+    for (auto _ : state) {
+        std::shared_ptr<Payload> copy = p;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+BENCHMARK(BM_Copy_LocalSharedPointer);
+BENCHMARK(BM_Copy_SharedPointer);
+BENCHMARK(BM_Copy_StdShared);
+
+BENCHMARK_MAIN();
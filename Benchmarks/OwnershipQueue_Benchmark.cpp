@@ -0,0 +1,118 @@
+#include <benchmark/benchmark.h>
+#include <OwnershipQueue.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Messages per second through a producers -> one consumer pipeline. Messages
+// are allocated before the timed section and moved in and out of the queue,
+// so the numbers compare the hand-off itself: a std::deque of std::shared_ptr
+// under one mutex versus the lock-free rings, which carry raw references.
+// Thread start-up is inside the timed section and is amortized over
+// kMessages per iteration.
+
+constexpr int kMessages = 1 << 16;
+
+struct Message : RefCounter {
+    int value = 0;
+};
+
+struct PlainMessage {
+    int value = 0;
+};
+
+class MutexDeque {
+public:
+    explicit MutexDeque(std::size_t) {}
+
+    bool TryPush(std::shared_ptr<PlainMessage>&& value) {
+        std::lock_guard lock(mutex_);
+        values_.push_back(std::move(value));
+        return true;
+    }
+
+    bool TryPop(std::shared_ptr<PlainMessage>& out) {
+        std::lock_guard lock(mutex_);
+        if (values_.empty()) {
+            return false;
+        }
+        out = std::move(values_.front());
+        values_.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<std::shared_ptr<PlainMessage>> values_;
+};
+
+template <class Queue, class Pointer, class Make>
+static void RunPipeline(benchmark::State& state, Make make) {
+    const int producers = static_cast<int>(state.range(0));
+    const int per_producer = kMessages / producers;
+    for (auto _ : state) {
+        state.PauseTiming();
+        Queue queue(1024);
+        std::vector<std::vector<Pointer>> inputs(producers);
+        for (auto& input : inputs) {
+            for (int i = 0; i < per_producer; ++i) {
+                input.push_back(make());
+            }
+        }
+        std::vector<Pointer> received;
+        received.reserve(per_producer * producers);
+        state.ResumeTiming();
+
+        std::vector<std::thread> threads;
+        for (auto& input : inputs) {
+            threads.emplace_back([&queue, &input] {
+                for (Pointer& message : input) {
+                    while (!queue.TryPush(std::move(message))) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        Pointer message;
+        while (received.size() < received.capacity()) {
+            if (queue.TryPop(message)) {
+                received.push_back(std::move(message));
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        state.PauseTiming();
+        received.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * per_producer * producers);
+}
+
+static void BM_Pipeline_MutexDeque(benchmark::State& state) {
+    RunPipeline<MutexDeque, std::shared_ptr<PlainMessage>>(state, [] { return std::make_shared<PlainMessage>(); });
+}
+
+static void BM_Pipeline_Spsc(benchmark::State& state) {
+    RunPipeline<SpscQueue<IntrusivePtr<Message>>, IntrusivePtr<Message>>(state, [] {
+        return make_intrusive<Message>();
+    });
+}
+
+static void BM_Pipeline_Mpmc(benchmark::State& state) {
+    RunPipeline<MpmcQueue<IntrusivePtr<Message>>, IntrusivePtr<Message>>(state, [] {
+        return make_intrusive<Message>();
+    });
+}
+
+BENCHMARK(BM_Pipeline_MutexDeque)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+BENCHMARK(BM_Pipeline_Spsc)->Arg(1)->UseRealTime();
+BENCHMARK(BM_Pipeline_Mpmc)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,155 @@
+#include <benchmark/benchmark.h>
+#include <PersistentHashMap.h>
+#include <PersistentVector.h>
+
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Snapshot-then-update workloads. Every iteration keeps the previous version
+// alive as a snapshot and applies state.range(1) updates to the current one.
+// The std containers have to copy the whole collection per snapshot; the
+// persistent ones copy only the paths they touch, and only once per snapshot.
+// The Transient variants apply the same updates with no snapshot held, so
+// every node is unique and changed in place.
+
+static std::vector<std::size_t> RandomIndices(std::size_t count, std::size_t bound) {
+    std::mt19937 random(42);
+    std::uniform_int_distribution<std::size_t> pick(0, bound - 1);
+    std::vector<std::size_t> indices(count);
+    for (auto& index : indices) {
+        index = pick(random);
+    }
+    return indices;
+}
+
+
+// VECTOR
+
+static void BM_VectorSnapshot_Persistent(benchmark::State& state) {
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto indices = RandomIndices(static_cast<std::size_t>(state.range(1)), size);
+    PersistentVector<int> current;
+    for (std::size_t i = 0; i < size; ++i) {
+        current.push_back(static_cast<int>(i));
+    }
+    int value = 0;
+    for (auto _ : state) {
+        PersistentVector<int> snapshot = current;
+        for (std::size_t index : indices) {
+            current.set(index, ++value);
+        }
+        benchmark::DoNotOptimize(snapshot);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+static void BM_VectorSnapshot_StdCopy(benchmark::State& state) {
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto indices = RandomIndices(static_cast<std::size_t>(state.range(1)), size);
+    std::vector<int> current(size);
+    int value = 0;
+    for (auto _ : state) {
+        std::vector<int> snapshot = current;
+        for (std::size_t index : indices) {
+            current[index] = ++value;
+        }
+        benchmark::DoNotOptimize(snapshot.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+static void BM_VectorUpdate_Transient(benchmark::State& state) {
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto indices = RandomIndices(static_cast<std::size_t>(state.range(1)), size);
+    PersistentVector<int> current;
+    for (std::size_t i = 0; i < size; ++i) {
+        current.push_back(static_cast<int>(i));
+    }
+    int value = 0;
+    for (auto _ : state) {
+        for (std::size_t index : indices) {
+            current.set(index, ++value);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+static void BM_VectorBuild_Persistent(benchmark::State& state) {
+    const auto size = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        PersistentVector<int> v;
+        for (int i = 0; i < size; ++i) {
+            v.push_back(i);
+        }
+        benchmark::DoNotOptimize(v);
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+
+// HASH MAP
+
+static void BM_MapSnapshot_Persistent(benchmark::State& state) {
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto keys = RandomIndices(static_cast<std::size_t>(state.range(1)), size);
+    PersistentHashMap<std::size_t, int> current;
+    for (std::size_t i = 0; i < size; ++i) {
+        current.set(i, 0);
+    }
+    int value = 0;
+    for (auto _ : state) {
+        PersistentHashMap<std::size_t, int> snapshot = current;
+        for (std::size_t key : keys) {
+            current.set(key, ++value);
+        }
+        benchmark::DoNotOptimize(snapshot);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+static void BM_MapSnapshot_StdCopy(benchmark::State& state) {
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto keys = RandomIndices(static_cast<std::size_t>(state.range(1)), size);
+    std::unordered_map<std::size_t, int> current;
+    for (std::size_t i = 0; i < size; ++i) {
+        current[i] = 0;
+    }
+    int value = 0;
+    for (auto _ : state) {
+        std::unordered_map<std::size_t, int> snapshot = current;
+        for (std::size_t key : keys) {
+            current[key] = ++value;
+        }
+        benchmark::DoNotOptimize(snapshot);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+static void BM_MapUpdate_Transient(benchmark::State& state) {
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto keys = RandomIndices(static_cast<std::size_t>(state.range(1)), size);
+    PersistentHashMap<std::size_t, int> current;
+    for (std::size_t i = 0; i < size; ++i) {
+        current.set(i, 0);
+    }
+    int value = 0;
+    for (auto _ : state) {
+        for (std::size_t key : keys) {
+            current.set(key, ++value);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+
+BENCHMARK(BM_VectorSnapshot_Persistent)->Args({1 << 16, 16})->Args({1 << 20, 16})->Args({1 << 20, 1024});
+BENCHMARK(BM_VectorSnapshot_StdCopy)->Args({1 << 16, 16})->Args({1 << 20, 16})->Args({1 << 20, 1024});
+BENCHMARK(BM_VectorUpdate_Transient)->Args({1 << 20, 1024});
+BENCHMARK(BM_VectorBuild_Persistent)->Arg(1 << 20);
+
+BENCHMARK(BM_MapSnapshot_Persistent)->Args({1 << 16, 16})->Args({1 << 20, 16})->Args({1 << 20, 1024});
+BENCHMARK(BM_MapSnapshot_StdCopy)->Args({1 << 16, 16})->Args({1 << 20, 16})->Args({1 << 20, 1024});
+BENCHMARK(BM_MapUpdate_Transient)->Args({1 << 20, 1024});
+
+BENCHMARK_MAIN();
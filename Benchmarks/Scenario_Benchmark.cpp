@@ -0,0 +1,377 @@
+#include <benchmark/benchmark.h>
+#include <IntrusivePtr.h>
+#include <SharedPointer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Scenario benchmarks: every scenario is written once against a pointer policy,
+// so IntrusivePtr, SharedPointer and std::shared_ptr run exactly the same code.
+
+struct NoBase {};
+
+struct IntrusivePolicy {
+    using Base = RefCounter;
+    template <class T> using Ptr = IntrusivePtr<T>;
+    template <class T> using Weak = IntrusiveWeakPtr<T>;
+
+    template <class T, class... Args>
+    static Ptr<T> Make(Args&&... args) { return make_intrusive<T>(std::forward<Args>(args)...); }
+    template <class T>
+    static Weak<T> MakeWeak(const Ptr<T>& p) { return Weak<T>(p); }
+    template <class T>
+    static Ptr<T> Lock(const Weak<T>& w) { return w.upgrade(); }
+    template <class T>
+    static void Assign(Ptr<T>& dst, const Ptr<T>& src) { dst = src; }
+};
+
+struct SharedPointerPolicy {
+    using Base = NoBase;
+    template <class T> using Ptr = SharedPointer<T>;
+    template <class T> using Weak = WeakPointer<T>;
+
+    template <class T, class... Args>
+    static Ptr<T> Make(Args&&... args) { return SharedPointer<T>(new T(std::forward<Args>(args)...)); }
+    template <class T>
+    static Weak<T> MakeWeak(const Ptr<T>& p) { return WeakPointer<T>(p); }
+    template <class T>
+    static Ptr<T> Lock(const Weak<T>& w) { return w.lock(); }
+    template <class T>
+    static void Assign(Ptr<T>& dst, const Ptr<T>& src) { dst = src; }
+};
+
+struct StdSharedPolicy {
+    using Base = NoBase;
+    template <class T> using Ptr = std::shared_ptr<T>;
+    template <class T> using Weak = std::weak_ptr<T>;
+
+    template <class T, class... Args>
+    static Ptr<T> Make(Args&&... args) { return std::make_shared<T>(std::forward<Args>(args)...); }
+    template <class T>
+    static Weak<T> MakeWeak(const Ptr<T>& p) { return p; }
+    template <class T>
+    static Ptr<T> Lock(const Weak<T>& w) { return w.lock(); }
+    template <class T>
+    static void Assign(Ptr<T>& dst, const Ptr<T>& src) { dst = src; }
+};
+
+
+// TREE / DAG
+// A complete binary tree and a layered lattice DAG (every node has two parents),
+// both with 1M nodes, built bottom-up and torn down by dropping the roots.
+
+constexpr int kGraphNodes = 1 << 20;
+
+template <class Policy>
+struct GraphNode : Policy::Base {
+    explicit GraphNode(int value = 0) : value(value) {}
+    int value = 0;
+    typename Policy::template Ptr<GraphNode> left;
+    typename Policy::template Ptr<GraphNode> right;
+};
+
+template <class Policy>
+static void BuildTree(benchmark::State& state) {
+    using Node = GraphNode<Policy>;
+    using Ptr = typename Policy::template Ptr<Node>;
+
+    for (auto _ : state) {
+        // Complete binary tree stored level by level: children of i are 2i+1, 2i+2.
+        std::vector<Ptr> level;
+        int first = kGraphNodes / 2;
+        for (int i = first; i < kGraphNodes; ++i) {
+            level.push_back(Policy::template Make<Node>(i));
+        }
+        while (level.size() > 1) {
+            std::vector<Ptr> parents;
+            parents.reserve(level.size() / 2);
+            for (std::size_t i = 0; i + 1 < level.size(); i += 2) {
+                auto parent = Policy::template Make<Node>(static_cast<int>(i));
+                Policy::Assign(parent->left, level[i]);
+                Policy::Assign(parent->right, level[i + 1]);
+                parents.push_back(std::move(parent));
+            }
+            level = std::move(parents);
+        }
+        benchmark::DoNotOptimize(level.front()->value);
+        level.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * kGraphNodes);
+}
+
+template <class Policy>
+static void BuildDag(benchmark::State& state) {
+    using Node = GraphNode<Policy>;
+    using Ptr = typename Policy::template Ptr<Node>;
+    constexpr int width = 1024;
+    constexpr int depth = kGraphNodes / width;
+
+    for (auto _ : state) {
+        std::vector<Ptr> layer;
+        layer.reserve(width);
+        for (int k = 0; k < width; ++k) {
+            layer.push_back(Policy::template Make<Node>(k));
+        }
+        for (int l = 1; l < depth; ++l) {
+            std::vector<Ptr> upper;
+            upper.reserve(width);
+            for (int k = 0; k < width; ++k) {
+                auto node = Policy::template Make<Node>(k);
+                Policy::Assign(node->left, layer[k]);
+                Policy::Assign(node->right, layer[(k + 1) % width]);
+                upper.push_back(std::move(node));
+            }
+            layer = std::move(upper);
+        }
+        benchmark::DoNotOptimize(layer.front()->value);
+        layer.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * kGraphNodes);
+}
+
+
+// LRU CACHE
+// Doubly linked recency list with strong forward links and weak back-links,
+// indexed by a hash map, queried with a Zipfian key distribution.
+
+class ZipfianKeys {
+public:
+    ZipfianKeys(int key_count, double skew, std::size_t sample_count) {
+        std::vector<double> cdf(key_count);
+        double sum = 0.0;
+        for (int i = 0; i < key_count; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), skew);
+            cdf[i] = sum;
+        }
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> uniform(0.0, sum);
+        samples_.reserve(sample_count);
+        for (std::size_t i = 0; i < sample_count; ++i) {
+            auto it = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng));
+            samples_.push_back(static_cast<int>(it - cdf.begin()));
+        }
+    }
+
+    [[nodiscard]] const std::vector<int>& samples() const { return samples_; }
+
+private:
+    std::vector<int> samples_;
+};
+
+template <class Policy>
+class LruCache {
+public:
+    struct Entry : Policy::Base {
+        explicit Entry(int key = 0) : key(key), payload(key) {}
+        int key = 0;
+        int payload = 0;
+        typename Policy::template Ptr<Entry> next;
+        typename Policy::template Weak<Entry> prev{};
+    };
+    using Ptr = typename Policy::template Ptr<Entry>;
+
+    explicit LruCache(std::size_t capacity) : capacity_(capacity) {
+        index_.reserve(capacity * 2);
+    }
+
+    ~LruCache() {
+        // Unlink iteratively so a long list does not recurse through destructors.
+        while (head_) {
+            Ptr next;
+            Policy::Assign(next, head_->next);
+            head_->next.reset();
+            Policy::Assign(head_, next);
+        }
+        tail_.reset();
+    }
+
+    int Get(int key) {
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            Ptr entry = it->second;
+            MoveToFront(entry);
+            return entry->payload;
+        }
+
+        Ptr entry = Policy::template Make<Entry>(key);
+        PushFront(entry);
+        index_.emplace(key, entry);
+        if (index_.size() > capacity_) {
+            EvictTail();
+        }
+        return entry->payload;
+    }
+
+private:
+    void Unlink(const Ptr& entry) {
+        Ptr prev = Policy::Lock(entry->prev);
+        Ptr next;
+        Policy::Assign(next, entry->next);
+        if (prev) {
+            Policy::Assign(prev->next, next);
+        } else {
+            Policy::Assign(head_, next);
+        }
+        if (next) {
+            next->prev = entry->prev;
+        } else {
+            Policy::Assign(tail_, prev);
+        }
+        entry->next.reset();
+        entry->prev = typename Policy::template Weak<Entry>();
+    }
+
+    void PushFront(const Ptr& entry) {
+        if (head_) {
+            head_->prev = Policy::MakeWeak(entry);
+            Policy::Assign(entry->next, head_);
+        } else {
+            Policy::Assign(tail_, entry);
+        }
+        Policy::Assign(head_, entry);
+    }
+
+    void MoveToFront(const Ptr& entry) {
+        if (head_.get() == entry.get()) {
+            return;
+        }
+        Unlink(entry);
+        PushFront(entry);
+    }
+
+    void EvictTail() {
+        Ptr victim = tail_;
+        Unlink(victim);
+        index_.erase(victim->key);
+    }
+
+    std::size_t capacity_;
+    std::unordered_map<int, Ptr> index_;
+    Ptr head_;
+    Ptr tail_;
+};
+
+template <class Policy>
+static void LruZipfian(benchmark::State& state) {
+    static const ZipfianKeys keys(1 << 16, 0.99, 1 << 20);
+    LruCache<Policy> cache(static_cast<std::size_t>(state.range(0)));
+    std::size_t cursor = 0;
+    for (auto _ : state) {
+        int key = keys.samples()[cursor++ & (keys.samples().size() - 1)];
+        benchmark::DoNotOptimize(cache.Get(key));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+
+// MESSAGE PIPELINE
+// Producer -> transform -> consumer, each stage on its own thread and connected
+// by bounded mutex queues. The transform stage keeps a short history of recent
+// messages, so every message is copied and released across threads.
+
+template <class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(std::size_t capacity) : capacity_(capacity) {}
+
+    void Push(T value) {
+        std::unique_lock lock(mutex_);
+        not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+        items_.push_back(std::move(value));
+        not_empty_.notify_one();
+    }
+
+    T Pop() {
+        std::unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this] { return !items_.empty(); });
+        T value = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return value;
+    }
+
+private:
+    std::size_t capacity_;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
+
+template <class Policy>
+struct Message : Policy::Base {
+    explicit Message(int id = 0) : id(id) {}
+    int id = 0;
+    int checksum = 0;
+};
+
+template <class Policy>
+static void Pipeline(benchmark::State& state) {
+    using Msg = Message<Policy>;
+    using Ptr = typename Policy::template Ptr<Msg>;
+    const int message_count = static_cast<int>(state.range(0));
+    constexpr std::size_t history_size = 64;
+
+    for (auto _ : state) {
+        BoundedQueue<Ptr> to_transform(1024);
+        BoundedQueue<Ptr> to_consume(1024);
+        long long total = 0;
+
+        std::thread producer([&] {
+            for (int i = 0; i < message_count; ++i) {
+                to_transform.Push(Policy::template Make<Msg>(i));
+            }
+            to_transform.Push(Ptr());
+        });
+
+        std::thread transform([&] {
+            std::vector<Ptr> history(history_size);
+            std::size_t slot = 0;
+            while (Ptr msg = to_transform.Pop()) {
+                msg->checksum = msg->id * 31;
+                Policy::Assign(history[slot++ % history_size], msg);
+                to_consume.Push(std::move(msg));
+            }
+            to_consume.Push(Ptr());
+        });
+
+        std::thread consumer([&] {
+            while (Ptr msg = to_consume.Pop()) {
+                total += msg->checksum;
+            }
+        });
+
+        producer.join();
+        transform.join();
+        consumer.join();
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetItemsProcessed(state.iterations() * message_count);
+}
+
+
+BENCHMARK_TEMPLATE(BuildTree, IntrusivePolicy)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BuildTree, SharedPointerPolicy)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BuildTree, StdSharedPolicy)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_TEMPLATE(BuildDag, IntrusivePolicy)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BuildDag, SharedPointerPolicy)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BuildDag, StdSharedPolicy)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_TEMPLATE(LruZipfian, IntrusivePolicy)->Arg(1 << 10)->Arg(1 << 14);
+BENCHMARK_TEMPLATE(LruZipfian, SharedPointerPolicy)->Arg(1 << 10)->Arg(1 << 14);
+BENCHMARK_TEMPLATE(LruZipfian, StdSharedPolicy)->Arg(1 << 10)->Arg(1 << 14);
+
+BENCHMARK_TEMPLATE(Pipeline, IntrusivePolicy)->Arg(100000)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(Pipeline, SharedPointerPolicy)->Arg(100000)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(Pipeline, StdSharedPolicy)->Arg(100000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
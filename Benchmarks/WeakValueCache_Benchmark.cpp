@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+#include <WeakValueCache.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Hit-path throughput across thread counts. Every key is loaded and held
+// before the timed loop, so each Get() is a hit. The baseline is the usual
+// single mutex around a map of SharedPointers.
+
+constexpr int kKeys = 4096;
+
+struct Resource {
+    explicit Resource(int id) : id(id) {}
+    int id;
+};
+
+class MutexCache {
+public:
+    SharedPointer<Resource> Get(int key) {
+        std::lock_guard lock(mutex_);
+        auto it = values_.find(key);
+        if (it != values_.end()) {
+            return it->second;
+        }
+        auto value = SharedPointer<Resource>(MakeUnique<Resource>(key));
+        values_.emplace(key, value);
+        return value;
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<int, SharedPointer<Resource>> values_;
+};
+
+static void BM_CacheHit_Mutex(benchmark::State& state) {
+    static MutexCache cache;
+    if (state.thread_index() == 0) {
+        for (int key = 0; key < kKeys; ++key) {
+            cache.Get(key);
+        }
+    }
+    int key = state.thread_index() * 257;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache.Get(key++ % kKeys));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_CacheHit_WeakValueCache(benchmark::State& state) {
+    static WeakValueCache<int, Resource> cache([](const int& key) {
+        return MakeUnique<Resource>(key);
+    });
+    static std::vector<SharedPointer<Resource>> held;
+    if (state.thread_index() == 0) {
+        for (int key = 0; key < kKeys; ++key) {
+            held.push_back(cache.Get(key));
+        }
+    }
+    int key = state.thread_index() * 257;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache.Get(key++ % kKeys));
+    }
+    if (state.thread_index() == 0) {
+        held.clear();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_CacheHit_Mutex)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BM_CacheHit_WeakValueCache)->ThreadRange(1, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,125 @@
+#ifndef _DEBUG
+#define _DEBUG
+#endif
+
+#include <Borrowed.h>
+#include <gtest/gtest.h>
+
+
+class Node : public RefCounter
+{
+public:
+    int value = 1;
+};
+
+struct Document
+{
+    int pages = 3;
+};
+
+struct Window : EnableSharedFromThis<Window>
+{
+    int width = 640;
+};
+
+static int ReadValue(IntrusiveRef<Node> node)
+{
+    return node->value;
+}
+
+static int ReadPages(Borrowed<Document> document)
+{
+    return document->pages;
+}
+
+TEST(BorrowedTest, IntrusiveRefDoesNotTouchCount)
+{
+    IntrusivePtr<Node> owner = make_intrusive<Node>();
+    EXPECT_EQ(ReadValue(owner), 1);
+    EXPECT_EQ(owner->GetRefCount(), 1);
+
+    IntrusiveRef<Node> ref(owner);
+    IntrusiveRef<Node> copy = ref;
+    EXPECT_EQ(copy.get(), owner.get());
+    EXPECT_EQ(owner->GetRefCount(), 1);
+}
+
+TEST(BorrowedTest, IntrusiveRefPromote)
+{
+    IntrusivePtr<Node> owner = make_intrusive<Node>();
+    IntrusivePtr<Node> promoted;
+    {
+        IntrusiveRef<Node> ref(owner);
+        promoted = ref.Promote();
+        EXPECT_EQ(owner->GetRefCount(), 2);
+    }
+    owner.reset();
+    EXPECT_EQ(promoted->value, 1);
+}
+
+TEST(BorrowedTest, BorrowedDoesNotTouchCount)
+{
+    SharedPointer<Document> owner(new Document());
+    EXPECT_EQ(ReadPages(owner), 3);
+    Borrowed<Document> borrowed(owner);
+    EXPECT_EQ(owner.use_count(), 1);
+}
+
+TEST(BorrowedTest, BorrowedPromote)
+{
+    SharedPointer<Document> owner(new Document());
+    SharedPointer<Document> promoted = Borrowed<Document>(owner).Promote();
+    EXPECT_EQ(promoted.get(), owner.get());
+    EXPECT_EQ(owner.use_count(), 2);
+
+    // Objects the registry does not know promote the same way.
+    SharedPointer<Document> unregistered = AllocateShared<Document>(std::allocator<Document>());
+    EXPECT_EQ(Borrowed<Document>(unregistered).Promote().get(), unregistered.get());
+    SharedPointer<Document> converted(MakeUnique<Document>());
+    EXPECT_EQ(Borrowed<Document>(converted).Promote().get(), converted.get());
+    EXPECT_EQ(converted.use_count(), 1);
+}
+
+TEST(BorrowedTest, NoBorrowFromTemporaries)
+{
+    static_assert(!std::is_constructible_v<IntrusiveRef<Node>, IntrusivePtr<Node>&&>);
+    static_assert(!std::is_constructible_v<Borrowed<Document>, SharedPointer<Document>&&>);
+    static_assert(std::is_constructible_v<Borrowed<Document>, SharedPointer<Document>&>);
+    static_assert(sizeof(Borrowed<Document>) == 2 * sizeof(void*));
+}
+
+TEST(BorrowedTest, BorrowedPromoteThroughSharedFromThis)
+{
+    SharedPointer<Window> owner = AllocateShared<Window>(std::allocator<Window>());
+    SharedPointer<Window> promoted = Borrowed<Window>(owner).Promote();
+    EXPECT_EQ(promoted.get(), owner.get());
+    EXPECT_EQ(owner.use_count(), 2);
+}
+
+TEST(BorrowedDeathTest, IntrusiveObjectDiesWhileBorrowed)
+{
+#ifdef NDEBUG
+    GTEST_SKIP() << "the borrow check is an assert";
+#endif
+    EXPECT_DEATH(
+        {
+            IntrusivePtr<Node> owner = make_intrusive<Node>();
+            IntrusiveRef<Node> ref(owner);
+            owner.reset();
+        },
+        "destroyed while borrowed");
+}
+
+TEST(BorrowedDeathTest, SharedObjectDiesWhileBorrowed)
+{
+#ifdef NDEBUG
+    GTEST_SKIP() << "the borrow check is an assert";
+#endif
+    EXPECT_DEATH(
+        {
+            SharedPointer<Document> owner(new Document());
+            Borrowed<Document> borrowed(owner);
+            owner.reset();
+        },
+        "destroyed while borrowed");
+}
@@ -0,0 +1,168 @@
+#ifndef SMARTPOINTERS_CENSUS
+#define SMARTPOINTERS_CENSUS
+#endif
+
+#include <CycleCollector.h>
+#include <IntrusivePtr.h>
+#include <SharedPointer.h>
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <typeinfo>
+#include <vector>
+
+
+class CensusNode : public RefCounter
+{
+public:
+    char payload[100] = {};
+};
+
+class CensusDerived : public CensusNode
+{
+public:
+    char more[400] = {};
+};
+
+class CensusCycleNode : public CycleCollectable
+{
+public:
+    void Trace(CycleTracer& tracer) override
+    {
+        tracer(next);
+    }
+
+    IntrusivePtr<CensusCycleNode> next;
+};
+
+struct CensusBlob
+{
+    double values[16] = {};
+};
+
+struct CensusShape
+{
+    virtual ~CensusShape() = default;
+};
+
+struct CensusCircle : CensusShape
+{
+    double radius[8] = {};
+};
+
+template <class Type>
+static Census::TypeCensus CensusFor()
+{
+    for (auto& type : Census::Snapshot())
+    {
+        if (type.name == typeid(Type).name())
+        {
+            return type;
+        }
+    }
+    return {};
+}
+
+TEST(CensusTest, CountsLiveIntrusiveObjects)
+{
+    std::vector<IntrusivePtr<CensusNode>> nodes;
+    for (int i = 0; i < 10; ++i)
+    {
+        nodes.push_back(make_intrusive<CensusNode>());
+    }
+    auto census = CensusFor<CensusNode>();
+    EXPECT_EQ(census.live, 10u);
+    EXPECT_EQ(census.live_bytes(), 10 * sizeof(CensusNode));
+
+    nodes.resize(4);
+    EXPECT_EQ(CensusFor<CensusNode>().live, 4u);
+    nodes.clear();
+    EXPECT_EQ(CensusFor<CensusNode>().live, 0u);
+}
+
+TEST(CensusTest, CountsByDynamicType)
+{
+    const auto base_before = CensusFor<CensusNode>();
+    {
+        IntrusivePtr<CensusNode> base;
+        {
+            auto derived = make_intrusive<CensusDerived>();
+            base = derived.get();
+        }
+        EXPECT_EQ(CensusFor<CensusDerived>().live, 1u);
+        EXPECT_EQ(CensusFor<CensusDerived>().object_size, sizeof(CensusDerived));
+        // The last release goes through IntrusivePtr<CensusNode>.
+    }
+    EXPECT_EQ(CensusFor<CensusDerived>().live, 0u);
+    EXPECT_EQ(CensusFor<CensusNode>().live, base_before.live);
+    EXPECT_EQ(CensusFor<CensusNode>().created, base_before.created);
+}
+
+TEST(CensusTest, CollectedCyclesAreUncounted)
+{
+    {
+        auto a = make_intrusive<CensusCycleNode>();
+        auto b = make_intrusive<CensusCycleNode>();
+        a->next = b;
+        b->next = a;
+    }
+    EXPECT_EQ(CensusFor<CensusCycleNode>().live, 2u);
+    EXPECT_EQ(CycleCollector::Instance().Collect(), 2u);
+    EXPECT_EQ(CensusFor<CensusCycleNode>().live, 0u);
+}
+
+TEST(CensusTest, CountsLiveSharedPointerObjects)
+{
+    std::size_t registered = ExternalRefCounter::Instance().LiveObjects();
+    {
+        SharedPointer<CensusBlob> a(new CensusBlob());
+        SharedPointer<CensusBlob> b(a);
+        EXPECT_EQ(CensusFor<CensusBlob>().live, 1u);
+        EXPECT_EQ(ExternalRefCounter::Instance().LiveObjects(), registered + 1);
+    }
+    EXPECT_EQ(CensusFor<CensusBlob>().live, 0u);
+    EXPECT_EQ(CensusFor<CensusBlob>().created, 1u);
+}
+
+TEST(CensusTest, SharedPointerCountsByDynamicType)
+{
+    const auto base_before = CensusFor<CensusShape>();
+    {
+        SharedPointer<CensusShape> shape(new CensusCircle());
+        EXPECT_EQ(CensusFor<CensusCircle>().live, 1u);
+        EXPECT_EQ(CensusFor<CensusShape>().live, base_before.live);
+    }
+    EXPECT_EQ(CensusFor<CensusCircle>().live, 0u);
+    EXPECT_EQ(CensusFor<CensusCircle>().created, 1u);
+
+    {
+        SharedPointer<CensusShape> shape = AllocateShared<CensusCircle>(std::allocator<CensusCircle>());
+        EXPECT_EQ(CensusFor<CensusCircle>().live, 1u);
+        EXPECT_EQ(CensusFor<CensusCircle>().object_size, sizeof(CensusCircle));
+    }
+    EXPECT_EQ(CensusFor<CensusCircle>().live, 0u);
+    EXPECT_EQ(CensusFor<CensusShape>().created, base_before.created);
+}
+
+TEST(CensusTest, LeakReportShowsSampledStacks)
+{
+    Census::SetSampleInterval(1);
+    auto* leaked = new CensusNode();
+    IntrusivePtr<CensusNode> keep(leaked);
+    {
+        auto dropped = make_intrusive<CensusNode>();
+    }
+
+    auto samples = Census::LiveSamples();
+    ASSERT_EQ(samples.size(), 1u);
+    EXPECT_EQ(samples.front().address, leaked);
+
+    std::ostringstream report;
+    Census::ReportLeaks(report);
+    EXPECT_NE(report.str().find(typeid(CensusNode).name()), std::string::npos);
+    EXPECT_NE(report.str().find("1 live"), std::string::npos);
+
+    keep.reset();
+    EXPECT_TRUE(Census::LiveSamples().empty());
+    Census::SetSampleInterval(1024);
+}
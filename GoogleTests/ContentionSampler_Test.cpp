@@ -0,0 +1,75 @@
+#ifndef SMARTPOINTERS_CONTENTION_SAMPLING
+#define SMARTPOINTERS_CONTENTION_SAMPLING
+#endif
+
+#include <IntrusivePtr.h>
+#include <SharedPointer.h>
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+class HotObject : public RefCounter
+{
+};
+
+class ColdObject : public RefCounter
+{
+};
+
+TEST(ContentionSamplerTest, RanksSharedObjectFirst)
+{
+    ContentionSampler::Reset();
+    ContentionSampler::Configure(16, 0);
+
+    auto hot = make_intrusive<HotObject>();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&hot]
+        {
+            for (int i = 0; i < 20000; ++i)
+            {
+                IntrusivePtr<HotObject> copy(hot);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    auto cold = make_intrusive<ColdObject>();
+    for (int i = 0; i < 1000; ++i)
+    {
+        IntrusivePtr<ColdObject> copy(cold);
+    }
+
+    auto ranked = ContentionSampler::Report();
+    ASSERT_GE(ranked.size(), 2u);
+    EXPECT_EQ(ranked.front().address, hot.get());
+    EXPECT_EQ(ranked.front().threads, 4u);
+    EXPECT_NE(std::string(ranked.front().type).find("HotObject"), std::string::npos);
+
+    ContentionSampler::Configure(1024, 2000);
+}
+
+TEST(ContentionSamplerTest, SamplesSharedPointerCounts)
+{
+    ContentionSampler::Reset();
+    ContentionSampler::Configure(1, 0);
+    {
+        SharedPointer<int> p(new int(1));
+        SharedPointer<int> q(p);
+    }
+    auto ranked = ContentionSampler::Report();
+    ASSERT_EQ(ranked.size(), 1u);
+    EXPECT_GE(ranked.front().samples, 2u);
+
+    std::ostringstream out;
+    ContentionSampler::PrintReport(out);
+    EXPECT_NE(out.str().find("samples"), std::string::npos);
+    ContentionSampler::Configure(1024, 2000);
+}
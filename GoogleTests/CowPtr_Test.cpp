@@ -0,0 +1,113 @@
+#include <CowPtr.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct Blob
+{
+    Blob() = default;
+
+    explicit Blob(int size) : data(size, 0)
+    {
+    }
+
+    Blob(const Blob& other) : data(other.data)
+    {
+        ++copies;
+    }
+
+    std::vector<int> data;
+    static inline std::atomic_int copies = 0;
+};
+
+
+TEST(CowPtrTest, CopiesShare)
+{
+    CowPtr<std::string> a(std::string("config"));
+    CowPtr<std::string> b = a;
+    EXPECT_TRUE(a.SharesWith(b));
+    EXPECT_EQ(a.use_count(), 2u);
+    EXPECT_EQ(*b, "config");
+    EXPECT_EQ(b->size(), 6u);
+}
+
+TEST(CowPtrTest, WriteToSharedClones)
+{
+    CowPtr<std::string> a(std::string("config"));
+    CowPtr<std::string> b = a;
+    b.Write() += "-changed";
+    EXPECT_FALSE(a.SharesWith(b));
+    EXPECT_EQ(*a, "config");
+    EXPECT_EQ(*b, "config-changed");
+    EXPECT_TRUE(a.unique());
+    EXPECT_TRUE(b.unique());
+}
+
+TEST(CowPtrTest, WriteToUniqueIsInPlace)
+{
+    Blob::copies = 0;
+    CowPtr<Blob> blob = MakeCow<Blob>(1024);
+    const Blob* before = blob.get();
+    for (int i = 0; i < 100; ++i)
+    {
+        blob.Write().data[i] = i;
+    }
+    EXPECT_EQ(blob.get(), before);
+    EXPECT_EQ(Blob::copies, 0);
+
+    // One clone per write that finds a sharer, none after that.
+    {
+        CowPtr<Blob> snapshot = blob;
+        blob.Write().data[0] = -1;
+        blob.Write().data[1] = -1;
+        EXPECT_EQ(Blob::copies, 1);
+        EXPECT_EQ(snapshot->data[0], 0);
+    }
+    EXPECT_TRUE(blob.unique());
+    blob.Write().data[2] = -1;
+    EXPECT_EQ(Blob::copies, 1);
+}
+
+TEST(CowPtrTest, MoveLeavesSourceEmpty)
+{
+    CowPtr<std::string> a(std::string("x"));
+    CowPtr<std::string> b = std::move(a);
+    EXPECT_EQ(*b, "x");
+    EXPECT_EQ(a.use_count(), 0u);
+    EXPECT_TRUE(b.unique());
+}
+
+TEST(CowPtrTest, ConcurrentWritersGetPrivateCopies)
+{
+    const CowPtr<Blob> original = MakeCow<Blob>(16);
+    const int thread_count = 8;
+    std::vector<std::thread> threads;
+    std::vector<int> sums(thread_count);
+    for (int t = 0; t < thread_count; ++t)
+    {
+        threads.emplace_back([&original, &sums, t]
+        {
+            for (int round = 0; round < 1000; ++round)
+            {
+                CowPtr<Blob> mine = original;
+                mine.Write().data[0] = t;
+                mine.Write().data[1] = round;
+                sums[t] += mine->data[0] == t ? 1 : 0;
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    for (int t = 0; t < thread_count; ++t)
+    {
+        EXPECT_EQ(sums[t], 1000);
+    }
+    EXPECT_EQ(original->data[0], 0);
+    EXPECT_TRUE(original.unique());
+}
@@ -0,0 +1,241 @@
+#include <CycleCollector.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+
+class GraphNode : public CycleCollectable
+{
+public:
+    explicit GraphNode(int* alive = nullptr) : alive(alive)
+    {
+        if (alive)
+        {
+            ++*alive;
+        }
+    }
+
+    ~GraphNode() override
+    {
+        if (alive)
+        {
+            --*alive;
+        }
+    }
+
+    void Trace(CycleTracer& tracer) override
+    {
+        ++traces;
+        for (IntrusivePtr<GraphNode>& edge : edges)
+        {
+            tracer(edge);
+        }
+    }
+
+    std::vector<IntrusivePtr<GraphNode>> edges;
+    int* alive;
+    static inline int traces = 0;
+};
+
+// Builds a ring of size nodes and returns its first node.
+static IntrusivePtr<GraphNode> MakeRing(int size, int* alive)
+{
+    IntrusivePtr<GraphNode> first = make_intrusive<GraphNode>(alive);
+    IntrusivePtr<GraphNode> last = first;
+    for (int i = 1; i < size; ++i)
+    {
+        IntrusivePtr<GraphNode> next = make_intrusive<GraphNode>(alive);
+        last->edges.push_back(next);
+        last = next;
+    }
+    last->edges.push_back(first);
+    return first;
+}
+
+TEST(CycleCollectorTest, AcyclicGraphNeedsNoCollection)
+{
+    int alive = 0;
+    {
+        IntrusivePtr<GraphNode> parent = make_intrusive<GraphNode>(&alive);
+        parent->edges.push_back(make_intrusive<GraphNode>(&alive));
+    }
+    EXPECT_EQ(alive, 0);
+    EXPECT_EQ(CycleCollector::Instance().Collect(), 0);
+}
+
+TEST(CycleCollectorTest, CollectsUnreachableCycle)
+{
+    int alive = 0;
+    MakeRing(3, &alive).reset();
+    EXPECT_EQ(alive, 3);
+    EXPECT_GE(CycleCollector::Instance().Candidates(), 1);
+
+    EXPECT_EQ(CycleCollector::Instance().Collect(), 3);
+    EXPECT_EQ(alive, 0);
+    EXPECT_EQ(CycleCollector::Instance().Candidates(), 0);
+}
+
+TEST(CycleCollectorTest, CollectsSelfLoop)
+{
+    int alive = 0;
+    {
+        IntrusivePtr<GraphNode> node = make_intrusive<GraphNode>(&alive);
+        node->edges.push_back(node);
+    }
+    EXPECT_EQ(CycleCollector::Instance().Collect(), 1);
+    EXPECT_EQ(alive, 0);
+}
+
+TEST(CycleCollectorTest, KeepsExternallyReferencedCycle)
+{
+    int alive = 0;
+    IntrusivePtr<GraphNode> ring = MakeRing(4, &alive);
+    IntrusivePtr<GraphNode> member = ring->edges[0];
+    ring.reset();
+
+    EXPECT_EQ(CycleCollector::Instance().Collect(), 0);
+    EXPECT_EQ(alive, 4);
+    EXPECT_EQ(member->edges[0]->edges[0]->edges[0]->edges[0].get(), member.get());
+
+    member.reset();
+    EXPECT_EQ(CycleCollector::Instance().Collect(), 4);
+    EXPECT_EQ(alive, 0);
+}
+
+TEST(CycleCollectorTest, GarbageReleasesLiveTargets)
+{
+    int alive = 0;
+    IntrusivePtr<GraphNode> survivor = make_intrusive<GraphNode>(&alive);
+    {
+        IntrusivePtr<GraphNode> ring = MakeRing(2, &alive);
+        ring->edges.push_back(survivor);
+    }
+    EXPECT_EQ(CycleCollector::Instance().Collect(), 2);
+    EXPECT_EQ(alive, 1);
+#ifdef _DEBUG
+    EXPECT_EQ(survivor->GetRefCount(), 1);
+#endif
+    survivor.reset();
+    EXPECT_EQ(alive, 0);
+}
+
+TEST(CycleCollectorTest, BudgetBoundsEachCall)
+{
+    int alive = 0;
+    for (int i = 0; i < 10; ++i)
+    {
+        MakeRing(5, &alive).reset();
+    }
+    EXPECT_EQ(alive, 50);
+
+    std::size_t freed = CycleCollector::Instance().Collect(3);
+    EXPECT_GT(freed, 0);
+    EXPECT_LE(freed, 15);
+    EXPECT_GT(alive, 0);
+
+    CycleCollector::Instance().Collect();
+    EXPECT_EQ(alive, 0);
+}
+
+TEST(CycleCollectorTest, StepsBoundTheWorkPerCall)
+{
+    CycleCollector& collector = CycleCollector::Instance();
+    int alive = 0;
+    MakeRing(10000, &alive).reset();
+    IntrusivePtr<GraphNode> kept = MakeRing(1000, &alive);
+    IntrusivePtr<GraphNode>(kept->edges[0]).reset();
+
+    int steps = 0;
+    bool finished = false;
+    while (!finished)
+    {
+        const int traces_before = GraphNode::traces;
+        finished = collector.Step(100);
+        // Every unit of work traces at most one object.
+        EXPECT_LE(GraphNode::traces - traces_before, 100);
+        ++steps;
+    }
+    EXPECT_GT(steps, 100);
+    EXPECT_EQ(collector.LastFreed(), 10000u);
+    EXPECT_EQ(alive, 1000);
+
+    // The live ring is intact and is found once it becomes garbage too.
+    kept.reset();
+    while (!collector.Step(64))
+    {
+    }
+    EXPECT_EQ(alive, 0);
+}
+
+TEST(CycleCollectorTest, CollectFinishesAStartedStep)
+{
+    CycleCollector& collector = CycleCollector::Instance();
+    int alive = 0;
+    MakeRing(100, &alive).reset();
+    EXPECT_FALSE(collector.Step(10));
+    EXPECT_EQ(alive, 100);
+
+    // Finishes the collection the step began. It is still marking, so it
+    // also takes candidates buffered since.
+    MakeRing(5, &alive).reset();
+    EXPECT_EQ(collector.Collect(), 105u);
+    EXPECT_EQ(alive, 0);
+    EXPECT_EQ(collector.Candidates(), 0u);
+}
+
+TEST(CycleCollectorTest, DeadCandidateLeavesBuffer)
+{
+    int alive = 0;
+    IntrusivePtr<GraphNode> node = make_intrusive<GraphNode>(&alive);
+    IntrusivePtr<GraphNode> copy = node;
+    copy.reset();
+    EXPECT_EQ(CycleCollector::Instance().Candidates(), 1);
+    node.reset();
+    EXPECT_EQ(CycleCollector::Instance().Candidates(), 0);
+    EXPECT_EQ(alive, 0);
+}
+
+TEST(CycleCollectorTest, AutoCollectIsOffByDefault)
+{
+    int alive = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        MakeRing(5, &alive).reset();
+    }
+    // No release collected on its own; everything waits for Collect().
+    EXPECT_EQ(alive, 5000);
+    EXPECT_EQ(CycleCollector::Instance().Candidates(), 5000u);
+
+    CycleCollector::Instance().Collect();
+    EXPECT_EQ(alive, 0);
+}
+
+TEST(CycleCollectorTest, ReleasesTriggerCollection)
+{
+    CycleCollector& collector = CycleCollector::Instance();
+    collector.SetAutoCollect(16, 16);
+    int alive = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        MakeRing(5, &alive).reset();
+    }
+    // Nobody called Collect(), yet most rings are gone and the buffer stays bounded.
+    EXPECT_LT(alive, 100);
+    EXPECT_LE(collector.Candidates(), 16u);
+
+    // A live self-loop keeps being buffered and collected around other
+    // garbage; it survives, and is still found once it becomes garbage too.
+    IntrusivePtr<GraphNode> kept = make_intrusive<GraphNode>(&alive);
+    kept->edges.push_back(kept);
+    for (int i = 0; i < 100; ++i)
+    {
+        MakeRing(5, &alive).reset();
+        IntrusivePtr<GraphNode> copy = kept;
+    }
+    EXPECT_EQ(kept->edges[0].get(), kept.get());
+    kept.reset();
+
+    collector.SetAutoCollect(0);
+    collector.Collect();
+    EXPECT_EQ(alive, 0);
+}
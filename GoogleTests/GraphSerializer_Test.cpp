@@ -0,0 +1,294 @@
+#include <GraphSerializer.h>
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+class Vertex : public RefCounter
+{
+public:
+    Vertex() = default;
+
+    explicit Vertex(std::string name) : name(std::move(name))
+    {
+    }
+
+    void Serialize(GraphWriter& out) const
+    {
+        out.Value(name);
+        out.Value(static_cast<std::uint32_t>(edges.size()));
+        for (const IntrusivePtr<Vertex>& edge : edges)
+        {
+            out.Reference(edge);
+        }
+    }
+
+    void Deserialize(GraphReader& in)
+    {
+        in.Value(name);
+        std::uint32_t count = 0;
+        in.Value(count);
+        edges.resize(count);
+        for (IntrusivePtr<Vertex>& edge : edges)
+        {
+            in.Reference(edge);
+        }
+    }
+
+    std::string name;
+    std::vector<IntrusivePtr<Vertex>> edges;
+};
+
+static GraphReader ReadBack(const GraphWriter& writer, std::vector<std::byte>& storage)
+{
+    storage = writer.Finish();
+    return GraphReader(storage);
+}
+
+
+TEST(GraphSerializerTest, SharedObjectIsWrittenOnce)
+{
+    // Diamond: top -> left, right -> bottom.
+    auto bottom = make_intrusive<Vertex>("bottom");
+    auto left = make_intrusive<Vertex>("left");
+    auto right = make_intrusive<Vertex>("right");
+    auto top = make_intrusive<Vertex>("top");
+    left->edges.push_back(bottom);
+    right->edges.push_back(bottom);
+    top->edges = {left, right};
+
+    GraphWriter writer;
+    EXPECT_EQ(writer.Write(top), 0u);
+    EXPECT_EQ(writer.ObjectCount(), 4u);
+
+    std::vector<std::byte> storage;
+    GraphReader reader = ReadBack(writer, storage);
+    IntrusivePtr<Vertex> loaded = reader.Load<Vertex>(0);
+    ASSERT_EQ(loaded->edges.size(), 2u);
+    EXPECT_EQ(loaded->edges[0]->name, "left");
+    EXPECT_EQ(loaded->edges[1]->name, "right");
+    EXPECT_EQ(loaded->edges[0]->edges[0].get(), loaded->edges[1]->edges[0].get());
+    EXPECT_EQ(loaded->edges[0]->edges[0]->name, "bottom");
+
+    // Two edges plus the reader's reference.
+    EXPECT_EQ(loaded->edges[0]->edges[0].use_count(), 3u);
+    reader.Forget();
+    EXPECT_EQ(loaded->edges[0]->edges[0].use_count(), 2u);
+    EXPECT_TRUE(loaded.unique());
+
+    // After Forget() the next load builds a fresh copy.
+    EXPECT_NE(reader.Load<Vertex>(0).get(), loaded.get());
+}
+
+TEST(GraphSerializerTest, RootsAddNoBytesOutsideRecords)
+{
+    GraphWriter writer;
+    EXPECT_EQ(writer.Write(make_intrusive<Vertex>("root")), 0u);
+    EXPECT_EQ(writer.Write(make_intrusive<Vertex>("next")), 1u);
+
+    // Header, three offsets, then two records of tag, name and edge count.
+    const std::size_t record = 8 + 8 + 4 + 4;
+    std::vector<std::byte> storage;
+    GraphReader reader = ReadBack(writer, storage);
+    EXPECT_EQ(storage.size(), 24 + 3 * 8 + 2 * record);
+    EXPECT_EQ(reader.Load<Vertex>(0)->name, "root");
+    EXPECT_EQ(reader.Load<Vertex>(1)->name, "next");
+}
+
+TEST(GraphSerializerTest, TemporaryRootsGetDistinctIds)
+{
+    // Each root dies with its statement unless the writer keeps it; a freed
+    // address reused by the next root must not turn it into a back-reference.
+    GraphWriter writer;
+    for (std::uint32_t i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(writer.Write(make_intrusive<Vertex>(std::to_string(i))), i);
+    }
+    EXPECT_EQ(writer.ObjectCount(), 100u);
+
+    std::vector<std::byte> storage;
+    GraphReader reader = ReadBack(writer, storage);
+    EXPECT_EQ(reader.Load<Vertex>(0)->name, "0");
+    EXPECT_EQ(reader.Load<Vertex>(99)->name, "99");
+}
+
+TEST(GraphSerializerTest, CyclesRoundTrip)
+{
+    auto a = make_intrusive<Vertex>("a");
+    auto b = make_intrusive<Vertex>("b");
+    a->edges.push_back(b);
+    b->edges.push_back(a);
+
+    GraphWriter writer;
+    writer.Write(a);
+    a->edges.clear();
+
+    std::vector<std::byte> storage;
+    GraphReader reader = ReadBack(writer, storage);
+    IntrusivePtr<Vertex> loaded = reader.Load<Vertex>(0);
+    EXPECT_EQ(loaded->edges[0]->edges[0].get(), loaded.get());
+    loaded->edges.clear();
+}
+
+TEST(GraphSerializerTest, LongChainLoadsWithoutRecursion)
+{
+    const int length = 200000;
+    auto head = make_intrusive<Vertex>("0");
+    IntrusivePtr<Vertex> tail = head;
+    for (int i = 1; i < length; ++i)
+    {
+        auto next = make_intrusive<Vertex>(std::to_string(i));
+        tail->edges.push_back(next);
+        tail = next;
+    }
+
+    GraphWriter writer;
+    writer.Write(head);
+    std::vector<std::byte> storage;
+    GraphReader reader = ReadBack(writer, storage);
+    IntrusivePtr<Vertex> loaded = reader.Load<Vertex>(0);
+    int count = 1;
+    for (const Vertex* node = loaded.get(); !node->edges.empty(); node = node->edges[0].get())
+    {
+        ++count;
+    }
+    EXPECT_EQ(count, length);
+    EXPECT_EQ(reader.Load<Vertex>(length - 1)->name, std::to_string(length - 1));
+
+    // Releasing a long chain recurses; unlink both copies front to back.
+    reader.Forget();
+    for (IntrusivePtr<Vertex> node : {loaded, head})
+    {
+        while (node && !node->edges.empty())
+        {
+            IntrusivePtr<Vertex> next = std::move(node->edges[0]);
+            node->edges.clear();
+            node = std::move(next);
+        }
+    }
+}
+
+TEST(GraphSerializerTest, LoadOnlyWhatIsAsked)
+{
+    std::vector<IntrusivePtr<Vertex>> roots;
+    GraphWriter writer;
+    for (int i = 0; i < 10; ++i)
+    {
+        roots.push_back(make_intrusive<Vertex>(std::to_string(i)));
+        roots.back()->edges.push_back(make_intrusive<Vertex>("child" + std::to_string(i)));
+        writer.Write(roots.back());
+    }
+    std::vector<std::byte> storage;
+    GraphReader reader = ReadBack(writer, storage);
+    EXPECT_EQ(reader.ObjectCount(), 20u);
+
+    // Root i is object 2i; loading it builds it and its child only.
+    IntrusivePtr<Vertex> fifth = reader.Load<Vertex>(10);
+    EXPECT_EQ(fifth->name, "5");
+    EXPECT_EQ(fifth->edges[0]->name, "child5");
+    EXPECT_EQ(reader.Load<Vertex>(11).get(), fifth->edges[0].get());
+}
+
+TEST(GraphSerializerTest, MappedFileRoundTrip)
+{
+    auto root = make_intrusive<Vertex>("root");
+    root->edges.push_back(make_intrusive<Vertex>("leaf"));
+    root->edges.push_back(root->edges[0]);
+    root->edges.emplace_back();
+
+    const std::string path = testing::TempDir() + "graph_serializer_test.bin";
+    GraphWriter writer;
+    writer.Write(root);
+    writer.Save(path);
+
+    {
+        GraphReader reader = GraphReader::Open(path);
+        IntrusivePtr<Vertex> loaded = reader.Load<Vertex>(0);
+        ASSERT_EQ(loaded->edges.size(), 3u);
+        EXPECT_EQ(loaded->edges[0].get(), loaded->edges[1].get());
+        EXPECT_EQ(loaded->edges[0]->name, "leaf");
+        EXPECT_FALSE(loaded->edges[2]);
+    }
+    std::remove(path.c_str());
+}
+
+TEST(GraphSerializerTest, CorruptInputThrows)
+{
+    auto root = make_intrusive<Vertex>("root");
+    GraphWriter writer;
+    writer.Write(root);
+    std::vector<std::byte> bytes = writer.Finish();
+
+    std::vector<std::byte> truncated(bytes.begin(), bytes.begin() + 8);
+    EXPECT_THROW(GraphReader{truncated}, std::runtime_error);
+
+    std::vector<std::byte> bad_magic = bytes;
+    bad_magic[0] = std::byte{0};
+    EXPECT_THROW(GraphReader{bad_magic}, std::runtime_error);
+
+    // A string length that runs past the record.
+    std::vector<std::byte> overrun = bytes;
+    overrun[overrun.size() - 4 - 4 - 8] = std::byte{0x7f};
+    GraphReader reader(overrun);
+    EXPECT_THROW(reader.Load<Vertex>(0), std::runtime_error);
+    // The half-read object is not kept for the next load.
+    EXPECT_THROW(reader.Load<Vertex>(0), std::runtime_error);
+    EXPECT_THROW(reader.Load<Vertex>(5), std::runtime_error);
+}
+
+class Weight : public RefCounter
+{
+public:
+    void Serialize(GraphWriter& out) const
+    {
+        out.Value(value);
+    }
+
+    void Deserialize(GraphReader& in)
+    {
+        in.Value(value);
+    }
+
+    double value = 0;
+};
+
+TEST(GraphSerializerTest, LoadingAsAnotherTypeThrows)
+{
+    auto root = make_intrusive<Vertex>("root");
+    root->edges.push_back(make_intrusive<Vertex>("leaf"));
+    GraphWriter writer;
+    writer.Write(root);
+    std::vector<std::byte> storage;
+    GraphReader reader = ReadBack(writer, storage);
+
+    EXPECT_THROW(reader.Load<Weight>(0), std::runtime_error);
+    // Also once the object has been built as its own type.
+    IntrusivePtr<Vertex> leaf = reader.Load<Vertex>(1);
+    EXPECT_THROW(reader.Load<Weight>(1), std::runtime_error);
+    EXPECT_EQ(reader.Load<Vertex>(0)->edges[0].get(), leaf.get());
+}
+
+TEST(GraphSerializerTest, FailedLoadIsRetriedFromScratch)
+{
+    // The root is fine; its second edge's string runs past the record.
+    auto root = make_intrusive<Vertex>("root");
+    root->edges.push_back(make_intrusive<Vertex>("a"));
+    root->edges.push_back(make_intrusive<Vertex>("b"));
+    GraphWriter writer;
+    writer.Write(root);
+    std::vector<std::byte> bytes = writer.Finish();
+    std::vector<std::byte> fixed = bytes;
+    bytes[bytes.size() - 4 - 1 - 8] = std::byte{0x7f};
+
+    GraphReader reader(bytes);
+    EXPECT_THROW(reader.Load<Vertex>(0), std::runtime_error);
+    EXPECT_THROW(reader.Load<Vertex>(0), std::runtime_error);
+    IntrusivePtr<Vertex> a = reader.Load<Vertex>(1);
+    EXPECT_EQ(a->name, "a");
+    EXPECT_EQ(a.use_count(), 2u);
+
+    GraphReader good(fixed);
+    EXPECT_EQ(good.Load<Vertex>(0)->edges[1]->name, "b");
+}
@@ -0,0 +1,106 @@
+#ifndef SMARTPOINTERS_INSTRUMENTATION
+#define SMARTPOINTERS_INSTRUMENTATION
+#endif
+
+#include <IntrusivePtr.h>
+#include <SharedPointer.h>
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+#include <typeinfo>
+
+
+class CountedObject : public RefCounter
+{
+};
+
+class DerivedCountedObject : public CountedObject
+{
+};
+
+struct PlainObject
+{
+    int value = 0;
+};
+
+template <class Type>
+static Instrumentation::TypeStats StatsFor()
+{
+    for (auto& stats : Instrumentation::Snapshot())
+    {
+        if (stats.name == typeid(Type).name())
+        {
+            return stats;
+        }
+    }
+    return {};
+}
+
+TEST(InstrumentationTest, IntrusiveCounts)
+{
+    {
+        auto p = make_intrusive<CountedObject>();
+        IntrusivePtr<CountedObject> q(p);
+        auto stats = StatsFor<CountedObject>();
+        EXPECT_EQ(stats.live, 1);
+        EXPECT_EQ(stats[Instrumentation::Event::AddRef], 2u);
+    }
+    auto stats = StatsFor<CountedObject>();
+    EXPECT_EQ(stats[Instrumentation::Event::Created], 1u);
+    EXPECT_EQ(stats[Instrumentation::Event::Destroyed], 1u);
+    EXPECT_EQ(stats[Instrumentation::Event::Release], 2u);
+    EXPECT_EQ(stats.live, 0);
+    EXPECT_EQ(stats.peak_live, 1);
+}
+
+TEST(InstrumentationTest, LiveCountsFollowTheDynamicType)
+{
+    const auto base_before = StatsFor<CountedObject>();
+    {
+        IntrusivePtr<CountedObject> base;
+        {
+            auto derived = make_intrusive<DerivedCountedObject>();
+            base = derived.get();
+        }
+        EXPECT_EQ(StatsFor<DerivedCountedObject>().live, 1);
+    }
+    const auto derived = StatsFor<DerivedCountedObject>();
+    EXPECT_EQ(derived[Instrumentation::Event::Created], 1u);
+    EXPECT_EQ(derived[Instrumentation::Event::Destroyed], 1u);
+    EXPECT_EQ(derived.live, 0);
+    EXPECT_EQ(derived.peak_live, 1);
+    EXPECT_EQ(StatsFor<CountedObject>().live, base_before.live);
+}
+
+TEST(InstrumentationTest, SharedPointerCounts)
+{
+    {
+        SharedPointer<PlainObject> a(new PlainObject());
+        SharedPointer<PlainObject> b(new PlainObject());
+        WeakPointer<PlainObject> weak(a);
+        EXPECT_TRUE(weak.lock());
+    }
+    auto stats = StatsFor<PlainObject>();
+    EXPECT_EQ(stats[Instrumentation::Event::Created], 2u);
+    EXPECT_EQ(stats[Instrumentation::Event::Destroyed], 2u);
+    EXPECT_EQ(stats[Instrumentation::Event::WeakLockHit], 1u);
+    EXPECT_GT(stats[Instrumentation::Event::MapLookup], 0u);
+    EXPECT_EQ(stats.peak_live, 2);
+}
+
+TEST(InstrumentationTest, ExitedThreadsAreAggregated)
+{
+    auto before = StatsFor<CountedObject>()[Instrumentation::Event::AddRef];
+    std::thread worker([] { auto p = make_intrusive<CountedObject>(); });
+    worker.join();
+    EXPECT_EQ(StatsFor<CountedObject>()[Instrumentation::Event::AddRef], before + 1);
+}
+
+TEST(InstrumentationTest, DumpJson)
+{
+    std::ostringstream out;
+    Instrumentation::DumpJson(out);
+    EXPECT_NE(out.str().find("\"enabled\":true"), std::string::npos);
+    EXPECT_NE(out.str().find("\"peak_live\""), std::string::npos);
+}
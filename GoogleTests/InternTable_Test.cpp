@@ -0,0 +1,109 @@
+#include <InternTable.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+
+class Symbol : public RefCounter
+{
+public:
+    explicit Symbol(std::string name) : name(std::move(name))
+    {
+    }
+
+    bool operator==(const Symbol& other) const
+    {
+        return name == other.name;
+    }
+
+    std::string name;
+};
+
+struct SymbolHash
+{
+    std::size_t operator()(const Symbol& symbol) const
+    {
+        return std::hash<std::string>{}(symbol.name);
+    }
+};
+
+using SymbolTable = InternTable<Symbol, SymbolHash>;
+
+
+TEST(InternTableTest, EqualValuesShareOneObject)
+{
+    SymbolTable table;
+    IntrusivePtr<Symbol> a = table.Intern(Symbol("alpha"));
+    IntrusivePtr<Symbol> b = table.Intern(Symbol("alpha"));
+    IntrusivePtr<Symbol> c = table.Intern(Symbol("beta"));
+    EXPECT_EQ(a.get(), b.get());
+    EXPECT_NE(a.get(), c.get());
+    EXPECT_EQ(a.use_count(), 2u);
+    EXPECT_EQ(table.size(), 2u);
+}
+
+TEST(InternTableTest, LastReleaseRemovesEntry)
+{
+    SymbolTable table;
+    const Symbol key("gamma");
+    IntrusivePtr<Symbol> a = table.Intern(key);
+    IntrusivePtr<Symbol> b = a;
+    a.reset();
+    EXPECT_EQ(table.size(), 1u);
+    b.reset();
+    EXPECT_EQ(table.size(), 0u);
+
+    IntrusivePtr<Symbol> again = table.Intern(key);
+    EXPECT_EQ(again->name, "gamma");
+    EXPECT_TRUE(again.unique());
+}
+
+TEST(InternTableTest, MemoryScalesWithUniqueValues)
+{
+    SymbolTable table;
+    std::vector<IntrusivePtr<Symbol>> symbols;
+    for (int i = 0; i < 10000; ++i)
+    {
+        symbols.push_back(table.Intern(Symbol("s" + std::to_string(i % 100))));
+    }
+    EXPECT_EQ(table.size(), 100u);
+    symbols.clear();
+    EXPECT_EQ(table.size(), 0u);
+}
+
+TEST(InternTableTest, ConcurrentInternAndRelease)
+{
+    SymbolTable table;
+    const int thread_count = 8;
+    std::vector<std::thread> threads;
+    std::vector<IntrusivePtr<Symbol>> kept(thread_count);
+    for (int t = 0; t < thread_count; ++t)
+    {
+        threads.emplace_back([&table, &kept, t]
+        {
+            for (int round = 0; round < 20000; ++round)
+            {
+                // Few distinct values, so lookups keep racing final releases.
+                IntrusivePtr<Symbol> symbol = table.Intern(Symbol("k" + std::to_string(round % 4)));
+                ASSERT_EQ(symbol->name, "k" + std::to_string(round % 4));
+                if (round % 4 == 0)
+                {
+                    kept[t] = symbol;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    for (int t = 1; t < thread_count; ++t)
+    {
+        EXPECT_EQ(kept[t].get(), kept[0].get());
+    }
+    EXPECT_EQ(table.size(), 1u);
+    kept.clear();
+    EXPECT_EQ(table.size(), 0u);
+}
@@ -1,6 +1,9 @@
 #include "IntrusivePtr.h"
 #include <gtest/gtest.h>
 
+#include <memory_resource>
+#include <thread>
+
 
 //Generate with OpenAI o1
 
@@ -44,6 +47,24 @@ TEST(IntrusivePtrTest, ConstructFromRawMultiple)
     EXPECT_FALSE(p);
 }
 
+TEST(IntrusivePtrTest, UseCountAndUnique)
+{
+    IntrusivePtr<TestObject> p = make_intrusive<TestObject>(1);
+    EXPECT_EQ(p.use_count(), 1u);
+    EXPECT_TRUE(p.unique());
+    IntrusivePtr<TestObject> q = p;
+    EXPECT_EQ(p.use_count(), 2u);
+    EXPECT_FALSE(p.unique());
+    q.reset();
+    EXPECT_TRUE(p.unique());
+
+    // Copying the object itself makes a new, unowned object.
+    IntrusivePtr<TestObject> copy(new TestObject(*p));
+    EXPECT_EQ(copy->value, 1);
+    EXPECT_TRUE(copy.unique());
+    EXPECT_TRUE(p.unique());
+}
+
 TEST(IntrusivePtrTest, CopyConstruction)
 {
     auto* obj = new TestObject(3);
@@ -764,3 +785,199 @@ TEST(IntrusivePtrTest, CopyChainCheck)
     s.reset();
     EXPECT_FALSE(p);
 }
+
+// Weak references
+
+class TrackedObject : public RefCounter
+{
+public:
+    explicit TrackedObject(bool* destroyed) : destroyed(destroyed)
+    {
+    }
+
+    ~TrackedObject() override
+    {
+        *destroyed = true;
+    }
+
+    bool* destroyed;
+};
+
+TEST(IntrusiveWeakPtrTest, DefaultIsExpired)
+{
+    IntrusiveWeakPtr<TestObject> w;
+    EXPECT_TRUE(w.expired());
+    EXPECT_FALSE(w.upgrade());
+}
+
+TEST(IntrusiveWeakPtrTest, UpgradeWhileAlive)
+{
+    auto p = make_intrusive<TestObject>(3001);
+    IntrusiveWeakPtr<TestObject> w(p);
+    EXPECT_FALSE(w.expired());
+    auto q = w.upgrade();
+    ASSERT_TRUE(q);
+    EXPECT_EQ(q.get(), p.get());
+    EXPECT_EQ(q->value, 3001);
+}
+
+TEST(IntrusiveWeakPtrTest, ExpiresWithLastStrongRef)
+{
+    bool destroyed = false;
+    IntrusivePtr<TrackedObject> p(new TrackedObject(&destroyed));
+    IntrusiveWeakPtr<TrackedObject> w(p);
+    IntrusiveWeakPtr<TrackedObject> copy(w);
+    p.reset();
+    EXPECT_TRUE(destroyed);
+    EXPECT_TRUE(w.expired());
+    EXPECT_FALSE(w.upgrade());
+    EXPECT_FALSE(copy.upgrade());
+}
+
+TEST(IntrusiveWeakPtrTest, WeakDoesNotKeepObjectAlive)
+{
+    bool destroyed = false;
+    IntrusiveWeakPtr<TrackedObject> w;
+    {
+        IntrusivePtr<TrackedObject> p(new TrackedObject(&destroyed));
+        w = p;
+    }
+    EXPECT_TRUE(destroyed);
+    EXPECT_TRUE(w.expired());
+}
+
+TEST(IntrusiveWeakPtrTest, UpgradedRefKeepsObjectAlive)
+{
+    bool destroyed = false;
+    IntrusivePtr<TrackedObject> p(new TrackedObject(&destroyed));
+    IntrusiveWeakPtr<TrackedObject> w(p);
+    auto q = w.upgrade();
+    p.reset();
+    EXPECT_FALSE(destroyed);
+    EXPECT_FALSE(w.expired());
+    q.reset();
+    EXPECT_TRUE(destroyed);
+}
+
+TEST(IntrusiveWeakPtrTest, CopyMoveAndReset)
+{
+    auto p = make_intrusive<TestObject>(3002);
+    IntrusiveWeakPtr<TestObject> a(p);
+    IntrusiveWeakPtr<TestObject> b;
+    b = a;
+    IntrusiveWeakPtr<TestObject> c(std::move(a));
+    EXPECT_TRUE(a.expired());
+    EXPECT_EQ(b.upgrade()->value, 3002);
+    EXPECT_EQ(c.upgrade()->value, 3002);
+    b.reset();
+    EXPECT_TRUE(b.expired());
+    EXPECT_FALSE(c.expired());
+}
+
+TEST(IntrusiveWeakPtrTest, ConcurrentUpgradeAndRelease)
+{
+    for (int round = 0; round < 200; ++round)
+    {
+        auto p = make_intrusive<TestObject>(round);
+        IntrusiveWeakPtr<TestObject> w(p);
+        std::thread upgrader([w]
+        {
+            for (int i = 0; i < 100; ++i)
+            {
+                if (auto q = w.upgrade())
+                {
+                    EXPECT_GE(q->value, 0);
+                }
+            }
+        });
+        p.reset();
+        upgrader.join();
+        EXPECT_TRUE(w.expired());
+    }
+}
+
+// Allocators and custom destruction
+
+template <class T>
+struct CountingAllocator
+{
+    using value_type = T;
+
+    explicit CountingAllocator(int* live) : live(live)
+    {
+    }
+
+    template <class U>
+    CountingAllocator(const CountingAllocator<U>& other) : live(other.live)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        ++*live;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        --*live;
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    int* live;
+};
+
+class PooledObject : public RefCounter
+{
+public:
+    explicit PooledObject(int* destroyed) : destroyed(destroyed)
+    {
+    }
+
+protected:
+    void Destroy() override
+    {
+        ++*destroyed;
+        delete this;
+    }
+
+private:
+    int* destroyed;
+};
+
+TEST(IntrusivePtrAllocationTest, DestroyOverride)
+{
+    int destroyed = 0;
+    {
+        IntrusivePtr<PooledObject> p(new PooledObject(&destroyed));
+        IntrusivePtr<PooledObject> copy = p;
+    }
+    EXPECT_EQ(destroyed, 1);
+}
+
+TEST(IntrusivePtrAllocationTest, AllocateIntrusive)
+{
+    int live = 0;
+    bool destroyed = false;
+    {
+        IntrusivePtr<TrackedObject> p = allocate_intrusive<TrackedObject>(CountingAllocator<TrackedObject>(&live),
+                                                                          &destroyed);
+        EXPECT_EQ(live, 1);
+        IntrusiveWeakPtr<TrackedObject> weak(p);
+        IntrusivePtr<TrackedObject> copy = weak.upgrade();
+        EXPECT_EQ(copy.get(), p.get());
+    }
+    EXPECT_TRUE(destroyed);
+    EXPECT_EQ(live, 0);
+}
+
+TEST(IntrusivePtrAllocationTest, AllocateIntrusiveFromMemoryResource)
+{
+    alignas(std::max_align_t) std::byte buffer[256];
+    std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+    IntrusivePtr<TestObject> p = allocate_intrusive<TestObject>(&resource, 7);
+    EXPECT_EQ(p->value, 7);
+    EXPECT_GE(reinterpret_cast<std::byte*>(p.get()), buffer);
+    EXPECT_LT(reinterpret_cast<std::byte*>(p.get()), buffer + sizeof(buffer));
+}
@@ -0,0 +1,150 @@
+#include <LocalSharedPointer.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+
+struct Probe
+{
+    explicit Probe(int* destroyed) : destroyed(destroyed)
+    {
+    }
+
+    ~Probe()
+    {
+        ++*destroyed;
+    }
+
+    int* destroyed;
+    int value = 9;
+};
+
+TEST(LocalSharedPointerTest, DefaultConstruct)
+{
+    LocalSharedPointer<int> p;
+    EXPECT_FALSE(p);
+    EXPECT_EQ(p.use_count(), 0);
+    EXPECT_FALSE(p.ToShared());
+}
+
+TEST(LocalSharedPointerTest, CopyMoveAndRelease)
+{
+    int destroyed = 0;
+    {
+        LocalSharedPointer<Probe> p = MakeLocalShared<Probe>(&destroyed);
+        LocalSharedPointer<Probe> copy = p;
+        EXPECT_EQ(p.use_count(), 2);
+        EXPECT_EQ(copy->value, 9);
+
+        LocalSharedPointer<Probe> moved = std::move(copy);
+        EXPECT_FALSE(copy);
+        EXPECT_EQ(p.use_count(), 2);
+
+        moved.reset();
+        EXPECT_TRUE(p.unique());
+        EXPECT_EQ(destroyed, 0);
+    }
+    EXPECT_EQ(destroyed, 1);
+}
+
+TEST(LocalSharedPointerTest, AdoptRawAndShared)
+{
+    LocalSharedPointer<std::string> raw(new std::string("local"));
+    EXPECT_EQ(*raw, "local");
+
+    SharedPointer<std::string> shared = AllocateShared<std::string>(std::allocator<std::string>(), "shared");
+    LocalSharedPointer<std::string> local(shared);
+    EXPECT_EQ(local.get(), shared.get());
+    EXPECT_EQ(shared.use_count(), 2);
+}
+
+TEST(LocalSharedPointerTest, EscapeToAnotherThread)
+{
+    int destroyed = 0;
+    LocalSharedPointer<Probe> p = MakeLocalShared<Probe>(&destroyed);
+    SharedPointer<Probe> escaped = p.ToShared();
+    EXPECT_EQ(escaped.get(), p.get());
+
+    p.reset();
+    EXPECT_EQ(destroyed, 0);
+
+    int seen = 0;
+    std::thread consumer([&seen, moved = std::move(escaped)]() mutable
+    {
+        seen = moved->value;
+        moved.reset();
+    });
+    consumer.join();
+    EXPECT_EQ(seen, 9);
+    EXPECT_EQ(destroyed, 1);
+}
+
+TEST(LocalSharedPointerTest, WeakPointer)
+{
+    int destroyed = 0;
+    LocalSharedPointer<Probe> p = MakeLocalShared<Probe>(&destroyed);
+    LocalWeakPointer<Probe> weak(p);
+    EXPECT_FALSE(weak.expired());
+
+    LocalSharedPointer<Probe> locked = weak.lock();
+    EXPECT_EQ(locked.get(), p.get());
+    EXPECT_EQ(p.use_count(), 2);
+
+    LocalWeakPointer<Probe> copy = weak;
+    p.reset();
+    locked.reset();
+    EXPECT_EQ(destroyed, 1);
+    EXPECT_TRUE(weak.expired());
+    EXPECT_TRUE(copy.expired());
+    EXPECT_FALSE(copy.lock());
+}
+
+TEST(LocalSharedPointerTest, WeakOutlivesInlineGroup)
+{
+    int destroyed = 0;
+    LocalWeakPointer<Probe> weak;
+    SharedPointer<Probe> escaped;
+    {
+        LocalSharedPointer<Probe> p = MakeLocalShared<Probe>(&destroyed);
+        weak = LocalWeakPointer<Probe>(p);
+        escaped = p.ToShared();
+        EXPECT_EQ(escaped.use_count(), 2);
+    }
+    // The local group is gone; the escaped owner keeps the object alive but
+    // the local weak pointer has expired.
+    EXPECT_EQ(destroyed, 0);
+    EXPECT_EQ(escaped.use_count(), 1);
+    EXPECT_TRUE(weak.expired());
+    EXPECT_FALSE(weak.lock());
+
+    escaped.reset();
+    EXPECT_EQ(destroyed, 1);
+    EXPECT_TRUE(weak.expired());
+}
+
+struct SelfAware : EnableSharedFromThis<SelfAware>
+{
+    int value = 4;
+};
+
+TEST(LocalSharedPointerTest, InlineGroupBindsSharedFromThis)
+{
+    LocalSharedPointer<SelfAware> p = MakeLocalShared<SelfAware>();
+    SharedPointer<SelfAware> self = p->SharedFromThis();
+    EXPECT_EQ(self.get(), p.get());
+    EXPECT_EQ(self.use_count(), 2);
+}
+
+#ifdef _DEBUG
+TEST(LocalSharedPointerDeathTest, CopyOnAnotherThreadAsserts)
+{
+    LocalSharedPointer<int> p(new int(1));
+    EXPECT_DEATH(
+        {
+            std::thread other([&p] { LocalSharedPointer<int> copy = p; });
+            other.join();
+        },
+        "another thread");
+}
+#endif
@@ -0,0 +1,189 @@
+#include <OwnershipQueue.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+struct Message : RefCounter
+{
+    explicit Message(int value) : value(value)
+    {
+        ++alive;
+    }
+
+    ~Message() override
+    {
+        --alive;
+    }
+
+    int value;
+    static inline std::atomic_int alive = 0;
+};
+
+
+TEST(OwnershipQueueTest, SpscMovesTheReference)
+{
+    SpscQueue<IntrusivePtr<Message>> queue(4);
+    EXPECT_EQ(queue.capacity(), 4u);
+
+    auto message = make_intrusive<Message>(1);
+    IntrusivePtr<Message> observer = message;
+    ASSERT_TRUE(queue.TryPush(std::move(message)));
+    EXPECT_FALSE(message);
+    EXPECT_EQ(observer.use_count(), 2u);
+
+    IntrusivePtr<Message> received;
+    ASSERT_TRUE(queue.TryPop(received));
+    EXPECT_EQ(received.get(), observer.get());
+    EXPECT_EQ(observer.use_count(), 2u);
+
+    // A failed pop leaves out alone.
+    EXPECT_FALSE(queue.TryPop(received));
+    EXPECT_EQ(received.get(), observer.get());
+}
+
+TEST(OwnershipQueueTest, SpscFullAndWrapAround)
+{
+    SpscQueue<IntrusivePtr<Message>> queue(3);
+    ASSERT_EQ(queue.capacity(), 4u);
+
+    IntrusivePtr<Message> received;
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            ASSERT_TRUE(queue.TryPush(make_intrusive<Message>(i)));
+        }
+        auto extra = make_intrusive<Message>(99);
+        EXPECT_FALSE(queue.TryPush(std::move(extra)));
+        // A failed push leaves the caller's pointer alone.
+        EXPECT_TRUE(extra);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            ASSERT_TRUE(queue.TryPop(received));
+            EXPECT_EQ(received->value, i);
+        }
+    }
+    received.reset();
+    EXPECT_EQ(Message::alive.load(), 0);
+}
+
+TEST(OwnershipQueueTest, DestructorReleasesQueuedElements)
+{
+    {
+        SpscQueue<IntrusivePtr<Message>> spsc(8);
+        MpmcQueue<IntrusivePtr<Message>> mpmc(8);
+        for (int i = 0; i < 5; ++i)
+        {
+            spsc.TryPush(make_intrusive<Message>(i));
+            mpmc.TryPush(make_intrusive<Message>(i));
+        }
+        EXPECT_EQ(Message::alive.load(), 10);
+    }
+    EXPECT_EQ(Message::alive.load(), 0);
+}
+
+TEST(OwnershipQueueTest, SharedPointerElements)
+{
+    MpmcQueue<SharedPointer<int>> queue(2);
+    SharedPointer<int> value(MakeUnique<int>(7));
+    SharedPointer<int> copy = value;
+    ASSERT_TRUE(queue.TryPush(std::move(copy)));
+    EXPECT_FALSE(copy);
+    EXPECT_EQ(value.use_count(), 2u);
+
+    SharedPointer<int> received;
+    ASSERT_TRUE(queue.TryPop(received));
+    EXPECT_EQ(received.get(), value.get());
+    EXPECT_EQ(value.use_count(), 2u);
+}
+
+TEST(OwnershipQueueTest, SpscAcrossThreads)
+{
+    const int count = 100000;
+    SpscQueue<IntrusivePtr<Message>> queue(64);
+
+    std::thread producer([&]
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            auto message = make_intrusive<Message>(i);
+            while (!queue.TryPush(std::move(message)))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    IntrusivePtr<Message> received;
+    for (int i = 0; i < count; ++i)
+    {
+        while (!queue.TryPop(received))
+        {
+            std::this_thread::yield();
+        }
+        ASSERT_EQ(received->value, i);
+        ASSERT_TRUE(received.unique());
+    }
+    producer.join();
+    received.reset();
+    EXPECT_EQ(Message::alive.load(), 0);
+}
+
+TEST(OwnershipQueueTest, MpmcDeliversEachMessageOnce)
+{
+    const int producers = 4;
+    const int consumers = 4;
+    const int per_producer = 20000;
+    MpmcQueue<IntrusivePtr<Message>> queue(128);
+    std::vector<std::atomic_int> seen(producers * per_producer);
+    std::atomic_int remaining = producers * per_producer;
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]
+        {
+            for (int i = 0; i < per_producer; ++i)
+            {
+                auto message = make_intrusive<Message>(p * per_producer + i);
+                while (!queue.TryPush(std::move(message)))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < consumers; ++c)
+    {
+        threads.emplace_back([&]
+        {
+            IntrusivePtr<Message> received;
+            while (remaining.load() > 0)
+            {
+                if (queue.TryPop(received))
+                {
+                    seen[received->value].fetch_add(1);
+                    remaining.fetch_sub(1);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (const std::atomic_int& hits : seen)
+    {
+        ASSERT_EQ(hits.load(), 1);
+    }
+    EXPECT_EQ(Message::alive.load(), 0);
+}
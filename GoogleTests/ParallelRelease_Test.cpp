@@ -0,0 +1,114 @@
+#include <ParallelRelease.h>
+#include <IntrusivePtr.h>
+#include <SharedPointer.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <vector>
+
+
+struct Counted : RefCounter
+{
+    Counted()
+    {
+        ++alive;
+    }
+
+    ~Counted() override
+    {
+        --alive;
+        ++destroyed;
+    }
+
+    static inline std::atomic_int alive = 0;
+    static inline std::atomic_int destroyed = 0;
+};
+
+static std::vector<IntrusivePtr<Counted>> MakeObjects(std::size_t count)
+{
+    std::vector<IntrusivePtr<Counted>> objects;
+    objects.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        objects.push_back(make_intrusive<Counted>());
+    }
+    return objects;
+}
+
+
+TEST(ParallelReleaseTest, ReleasesEveryElement)
+{
+    auto objects = MakeObjects(100000);
+    ParallelRelease(objects, 4);
+    EXPECT_EQ(objects.size(), 100000u);
+    for (const auto& object : objects)
+    {
+        ASSERT_FALSE(object);
+    }
+    EXPECT_EQ(Counted::alive.load(), 0);
+}
+
+TEST(ParallelReleaseTest, SharedObjectsAreDestroyedOnce)
+{
+    // Every object is owned by four elements spread across the range.
+    const std::size_t distinct = 50000;
+    auto originals = MakeObjects(distinct);
+    std::vector<IntrusivePtr<Counted>> owners;
+    for (int copy = 0; copy < 4; ++copy)
+    {
+        owners.insert(owners.end(), originals.begin(), originals.end());
+    }
+    originals.clear();
+
+    Counted::destroyed = 0;
+    ParallelClear(owners, 8);
+    EXPECT_TRUE(owners.empty());
+    EXPECT_EQ(Counted::destroyed.load(), static_cast<int>(distinct));
+    EXPECT_EQ(Counted::alive.load(), 0);
+}
+
+TEST(ParallelReleaseTest, SmallRangesAndOddThreadCounts)
+{
+    for (const std::size_t count : {std::size_t{0}, std::size_t{1}, std::size_t{100}, kMinParallelRelease + 1})
+    {
+        for (const unsigned int threads : {0u, 1u, 3u, 64u})
+        {
+            auto objects = MakeObjects(count);
+            ParallelClear(objects, threads);
+            ASSERT_EQ(Counted::alive.load(), 0) << count << " elements, " << threads << " threads";
+        }
+    }
+}
+
+template <class Range>
+concept Releasable = requires(Range range) { ParallelRelease(range); };
+
+TEST(ParallelReleaseTest, RejectsUnsizedRanges)
+{
+    using Unsized = std::ranges::subrange<std::vector<IntrusivePtr<Counted>>::iterator, std::unreachable_sentinel_t>;
+    static_assert(std::ranges::random_access_range<Unsized> && !std::ranges::sized_range<Unsized>);
+    static_assert(!Releasable<Unsized>);
+    static_assert(Releasable<std::vector<IntrusivePtr<Counted>>&>);
+}
+
+TEST(ParallelReleaseTest, OtherPointerTypes)
+{
+    std::vector<SharedPointer<int>> shared;
+    std::vector<std::unique_ptr<Counted>> unique;
+    for (int i = 0; i < 40000; ++i)
+    {
+        shared.emplace_back(MakeUnique<int>(i));
+        unique.push_back(std::make_unique<Counted>());
+    }
+    SharedPointer<int> kept = shared[123];
+
+    ParallelClear(shared, 4);
+    ParallelClear(unique, 4);
+    EXPECT_TRUE(shared.empty());
+    EXPECT_EQ(*kept, 123);
+    EXPECT_EQ(kept.use_count(), 1u);
+    EXPECT_EQ(Counted::alive.load(), 0);
+}
@@ -0,0 +1,194 @@
+#include <PersistentHashMap.h>
+#include <PersistentVector.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <unordered_map>
+
+
+// Element that counts its copies, to tell in-place updates from path copies.
+struct Counted
+{
+    Counted(int value = 0) : value(value)
+    {
+    }
+
+    Counted(const Counted& other) : value(other.value)
+    {
+        ++copies;
+    }
+
+    Counted(Counted&&) noexcept = default;
+    Counted& operator=(const Counted&) = default;
+    Counted& operator=(Counted&&) noexcept = default;
+
+    int value;
+    static inline int copies = 0;
+};
+
+// Every key lands in the same bucket chain, down to the collision nodes.
+struct ConstantHash
+{
+    std::size_t operator()(int) const
+    {
+        return 7;
+    }
+};
+
+
+TEST(PersistentVectorTest, PushBackAndIndex)
+{
+    PersistentVector<int> v;
+    EXPECT_TRUE(v.empty());
+    // Enough elements for a three-level trie.
+    const int size = 40000;
+    for (int i = 0; i < size; ++i)
+    {
+        v.push_back(i);
+    }
+    ASSERT_EQ(v.size(), static_cast<std::size_t>(size));
+    for (int i = 0; i < size; ++i)
+    {
+        ASSERT_EQ(v[i], i);
+    }
+}
+
+TEST(PersistentVectorTest, SnapshotsAreIndependent)
+{
+    PersistentVector<std::string> v;
+    for (int i = 0; i < 2000; ++i)
+    {
+        v.push_back(std::to_string(i));
+    }
+    PersistentVector<std::string> snapshot = v;
+    v.set(5, "five");
+    v.set(1999, "last");
+    v.push_back("new");
+
+    EXPECT_EQ(v[5], "five");
+    EXPECT_EQ(v[1999], "last");
+    EXPECT_EQ(v.size(), 2001u);
+    EXPECT_EQ(snapshot[5], "5");
+    EXPECT_EQ(snapshot[1999], "1999");
+    EXPECT_EQ(snapshot.size(), 2000u);
+}
+
+TEST(PersistentVectorTest, UniqueVectorUpdatesInPlace)
+{
+    PersistentVector<Counted> v;
+    for (int i = 0; i < 1000; ++i)
+    {
+        v.push_back(Counted(i));
+    }
+
+    Counted::copies = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        v.set(i, Counted(-i));
+    }
+    EXPECT_EQ(Counted::copies, 0);
+
+    // After a snapshot, the first update of a leaf copies it once; later
+    // updates of the same leaf are in place again.
+    PersistentVector<Counted> snapshot = v;
+    v.set(0, Counted(1));
+    EXPECT_EQ(Counted::copies, 32);
+    v.set(1, Counted(2));
+    EXPECT_EQ(Counted::copies, 32);
+    EXPECT_EQ(snapshot[0].value, 0);
+    EXPECT_EQ(snapshot[1].value, -1);
+}
+
+TEST(PersistentHashMapTest, SetFindErase)
+{
+    PersistentHashMap<int, int> map;
+    const int size = 20000;
+    for (int i = 0; i < size; ++i)
+    {
+        EXPECT_TRUE(map.set(i, i * 2));
+    }
+    EXPECT_FALSE(map.set(10, -1));
+    ASSERT_EQ(map.size(), static_cast<std::size_t>(size));
+    EXPECT_EQ(*map.find(10), -1);
+    for (int i = 0; i < size; i += 2)
+    {
+        EXPECT_TRUE(map.erase(i));
+    }
+    EXPECT_FALSE(map.erase(0));
+    EXPECT_EQ(map.size(), static_cast<std::size_t>(size / 2));
+    for (int i = 1; i < size; i += 2)
+    {
+        ASSERT_NE(map.find(i), nullptr);
+        EXPECT_EQ(*map.find(i), i * 2);
+    }
+    EXPECT_FALSE(map.contains(4));
+}
+
+TEST(PersistentHashMapTest, SnapshotsAreIndependent)
+{
+    PersistentHashMap<std::string, int> map;
+    for (int i = 0; i < 500; ++i)
+    {
+        map.set(std::to_string(i), i);
+    }
+    PersistentHashMap<std::string, int> snapshot = map;
+    map.set("7", 70);
+    map.erase("8");
+    map.set("new", 1);
+
+    EXPECT_EQ(*map.find("7"), 70);
+    EXPECT_FALSE(map.contains("8"));
+    EXPECT_EQ(map.size(), 500u);
+    EXPECT_EQ(*snapshot.find("7"), 7);
+    EXPECT_TRUE(snapshot.contains("8"));
+    EXPECT_FALSE(snapshot.contains("new"));
+    EXPECT_EQ(snapshot.size(), 500u);
+}
+
+TEST(PersistentHashMapTest, FullHashCollisions)
+{
+    PersistentHashMap<int, int, ConstantHash> map;
+    for (int i = 0; i < 10; ++i)
+    {
+        map.set(i, i);
+    }
+    PersistentHashMap<int, int, ConstantHash> snapshot = map;
+    for (int i = 0; i < 9; ++i)
+    {
+        EXPECT_TRUE(map.erase(i));
+    }
+    EXPECT_EQ(map.size(), 1u);
+    EXPECT_EQ(*map.find(9), 9);
+    EXPECT_EQ(snapshot.size(), 10u);
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_EQ(*snapshot.find(i), i);
+    }
+}
+
+TEST(PersistentHashMapTest, MatchesUnorderedMap)
+{
+    PersistentHashMap<int, int> map;
+    std::unordered_map<int, int> expected;
+    unsigned int state = 1;
+    for (int i = 0; i < 50000; ++i)
+    {
+        state = state * 1103515245u + 12345u;
+        const int key = static_cast<int>((state >> 8) % 4096);
+        if ((state >> 4) % 3 == 0)
+        {
+            EXPECT_EQ(map.erase(key), expected.erase(key) == 1);
+        }
+        else
+        {
+            EXPECT_EQ(map.set(key, i), !expected.contains(key));
+            expected[key] = i;
+        }
+    }
+    ASSERT_EQ(map.size(), expected.size());
+    for (const auto& [key, value] : expected)
+    {
+        ASSERT_NE(map.find(key), nullptr);
+        EXPECT_EQ(*map.find(key), value);
+    }
+}
@@ -0,0 +1,169 @@
+#include <QueuedDestruction.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+
+struct ChainNode : QueuedDestruction
+{
+    ChainNode()
+    {
+        ++alive;
+    }
+
+    ~ChainNode() override
+    {
+        --alive;
+    }
+
+    IntrusivePtr<ChainNode> next;
+    std::vector<IntrusivePtr<ChainNode>> children;
+    static inline std::atomic_int alive = 0;
+};
+
+static std::atomic<std::size_t> pending_after_release = 0;
+
+static IntrusivePtr<ChainNode> MakeChain(int length)
+{
+    IntrusivePtr<ChainNode> head;
+    for (int i = 0; i < length; ++i)
+    {
+        auto node = make_intrusive<ChainNode>();
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    return head;
+}
+
+
+TEST(QueuedDestructionTest, LongChainDoesNotRecurse)
+{
+    // Deep enough to overflow the default stack if released recursively.
+    IntrusivePtr<ChainNode> head = MakeChain(1000000);
+    EXPECT_EQ(ChainNode::alive, 1000000);
+    head.reset();
+    EXPECT_EQ(ChainNode::alive, 0);
+    EXPECT_EQ(QueuedDestruction::Pending(), 0u);
+}
+
+TEST(QueuedDestructionTest, TreesAreFullyDestroyed)
+{
+    auto root = make_intrusive<ChainNode>();
+    std::vector<ChainNode*> level = {root.get()};
+    for (int depth = 0; depth < 10; ++depth)
+    {
+        std::vector<ChainNode*> next_level;
+        for (ChainNode* node : level)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                node->children.push_back(make_intrusive<ChainNode>());
+                next_level.push_back(node->children.back().get());
+            }
+        }
+        level = std::move(next_level);
+    }
+    root.reset();
+    EXPECT_EQ(ChainNode::alive, 0);
+}
+
+TEST(QueuedDestructionTest, BudgetSpreadsTeardown)
+{
+    IntrusivePtr<ChainNode> head = MakeChain(100);
+    QueuedDestruction::SetReleaseBudget(10);
+    head.reset();
+    EXPECT_EQ(ChainNode::alive, 90);
+    EXPECT_EQ(QueuedDestruction::Pending(), 1u);
+
+    EXPECT_EQ(QueuedDestruction::Drain(30), 1u);
+    EXPECT_EQ(ChainNode::alive, 60);
+
+    // A later release on the same thread continues the work within its budget;
+    // its own object joins the back of the queue.
+    MakeChain(1).reset();
+    EXPECT_EQ(ChainNode::alive, 51);
+
+    QueuedDestruction::SetReleaseBudget(0);
+    EXPECT_EQ(QueuedDestruction::Drain(), 0u);
+    EXPECT_EQ(ChainNode::alive, 0);
+}
+
+TEST(QueuedDestructionTest, WeakReferencesExpireBeforeTheDeferredDestructor)
+{
+    IntrusivePtr<ChainNode> head = MakeChain(3);
+    // The second node is queued, not yet destroyed, once head is gone.
+    IntrusiveWeakPtr<ChainNode> weak_second(head->next);
+    QueuedDestruction::SetReleaseBudget(1);
+    head.reset();
+    EXPECT_EQ(ChainNode::alive, 2);
+    EXPECT_FALSE(weak_second.upgrade());
+
+    QueuedDestruction::SetReleaseBudget(0);
+    QueuedDestruction::Drain();
+    EXPECT_EQ(ChainNode::alive, 0);
+}
+
+TEST(QueuedDestructionTest, AllocatedObjectsGoBackToTheirResource)
+{
+    std::pmr::monotonic_buffer_resource upstream;
+    std::pmr::unsynchronized_pool_resource pool(&upstream);
+    IntrusivePtr<ChainNode> head;
+    for (int i = 0; i < 10000; ++i)
+    {
+        auto node = allocate_intrusive<ChainNode>(&pool);
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    head.reset();
+    EXPECT_EQ(ChainNode::alive, 0);
+}
+
+TEST(QueuedDestructionTest, ThreadExitDestroysWhatIsLeft)
+{
+    IntrusivePtr<ChainNode> head = MakeChain(1000);
+    ChainNode* tail = head.get();
+    while (tail->next)
+    {
+        tail = tail->next.get();
+    }
+    IntrusiveWeakPtr<ChainNode> weak_tail{IntrusivePtr<ChainNode>(tail)};
+
+    std::thread worker([chain = std::move(head)]() mutable
+    {
+        QueuedDestruction::SetReleaseBudget(1);
+        chain.reset();
+        EXPECT_GT(QueuedDestruction::Pending(), 0u);
+    });
+    worker.join();
+    EXPECT_FALSE(weak_tail.upgrade());
+    EXPECT_EQ(ChainNode::alive, 0);
+}
+
+TEST(QueuedDestructionTest, ReleaseFromThreadLocalDestructor)
+{
+    struct Holder
+    {
+        ~Holder()
+        {
+            chain.reset();
+            pending_after_release = QueuedDestruction::Pending();
+        }
+
+        IntrusivePtr<ChainNode> chain;
+    };
+
+    pending_after_release = 1;
+    std::thread worker([]
+    {
+        // Constructed before this thread's queue, so destroyed after it.
+        thread_local Holder holder;
+        holder.chain = MakeChain(1000);
+        EXPECT_EQ(QueuedDestruction::Pending(), 0u);
+    });
+    worker.join();
+    EXPECT_EQ(pending_after_release, 0u);
+    EXPECT_EQ(ChainNode::alive, 0);
+}
@@ -0,0 +1,23 @@
+#include <SharedPointer.h>
+
+// Second translation unit for Registry_Test.cpp.
+
+ExternalRefCounter* RegistryOfHelperUnit()
+{
+    return &ExternalRefCounter::Instance();
+}
+
+SharedPointer<int> MakeInHelperUnit(int value)
+{
+    return SharedPointer<int>(new int(value));
+}
+
+SharedPointer<int> AdoptInHelperUnit(int* raw)
+{
+    return SharedPointer<int>(raw);
+}
+
+void ReleaseInHelperUnit(SharedPointer<int>& pointer)
+{
+    pointer.reset();
+}
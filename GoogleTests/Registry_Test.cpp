@@ -0,0 +1,51 @@
+#include <SharedPointer.h>
+#include <gtest/gtest.h>
+
+// Defined in Registry_Helper.cpp, which is compiled as a separate translation unit.
+ExternalRefCounter* RegistryOfHelperUnit();
+SharedPointer<int> MakeInHelperUnit(int value);
+SharedPointer<int> AdoptInHelperUnit(int* raw);
+void ReleaseInHelperUnit(SharedPointer<int>& pointer);
+
+
+TEST(RegistryTest, OneRegistryPerProcess)
+{
+    EXPECT_EQ(RegistryOfHelperUnit(), &ExternalRefCounter::Instance());
+}
+
+TEST(RegistryTest, CreatedInOneUnitReleasedInAnother)
+{
+    const std::size_t before = ExternalRefCounter::Instance().LiveObjects();
+    SharedPointer<int> p = MakeInHelperUnit(7);
+    EXPECT_EQ(ExternalRefCounter::Instance().LiveObjects(), before + 1);
+    EXPECT_EQ(*p, 7);
+
+    p.reset();
+    EXPECT_EQ(ExternalRefCounter::Instance().LiveObjects(), before);
+}
+
+TEST(RegistryTest, SameRawPointerAdoptedInBothUnits)
+{
+    int* raw = new int(3);
+    SharedPointer<int> here(raw);
+    SharedPointer<int> there = AdoptInHelperUnit(raw);
+    EXPECT_EQ(here.use_count(), 2);
+
+    ReleaseInHelperUnit(there);
+    EXPECT_TRUE(here.unique());
+}
+
+TEST(RegistryTest, InjectedRegistry)
+{
+    ExternalRefCounter subsystem;
+    const std::size_t global = ExternalRefCounter::Instance().LiveObjects();
+    {
+        int* raw = new int(1);
+        SharedPointer<int> p(raw, subsystem);
+        SharedPointer<int> again(raw, subsystem);
+        EXPECT_EQ(p.use_count(), 2);
+        EXPECT_EQ(subsystem.LiveObjects(), 1);
+        EXPECT_EQ(ExternalRefCounter::Instance().LiveObjects(), global);
+    }
+    EXPECT_EQ(subsystem.LiveObjects(), 0);
+}
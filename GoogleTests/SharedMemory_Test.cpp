@@ -0,0 +1,206 @@
+#include <SharedMemory.h>
+#include <gtest/gtest.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+struct ListNode : ShmRefCounter
+{
+    explicit ListNode(int value, ShmPtr<ListNode> next = ShmPtr<ListNode>()) : value(value), next(std::move(next))
+    {
+    }
+
+    int value;
+    ShmPtr<ListNode> next;
+};
+
+struct Counter : ShmRefCounter
+{
+    std::atomic<int> hits = 0;
+};
+
+static ShmPtr<ListNode> MakeList(ShmSegment& segment, int length)
+{
+    ShmPtr<ListNode> head;
+    for (int i = length; i > 0; --i)
+    {
+        head = MakeShm<ListNode>(segment, i, std::move(head));
+    }
+    return head;
+}
+
+static int SumList(const ShmPtr<ListNode>& head)
+{
+    int sum = 0;
+    for (const ListNode* node = head.get(); node != nullptr; node = node->next.get())
+    {
+        sum += node->value;
+    }
+    return sum;
+}
+
+static int WaitForChild(pid_t child)
+{
+    int status = 0;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+
+TEST(OffsetPtrTest, SurvivesCopyToAnotherAddress)
+{
+    struct Pair
+    {
+        int target = 5;
+        OffsetPtr<int> pointer;
+    };
+
+    Pair first;
+    first.pointer = &first.target;
+    EXPECT_EQ(*first.pointer, 5);
+
+    Pair second = first;
+    // Copying recomputes the distance, so it still points at first.target.
+    EXPECT_EQ(second.pointer.get(), &first.target);
+    EXPECT_FALSE(OffsetPtr<int>());
+}
+
+TEST(SharedMemoryTest, AllocationIsReclaimed)
+{
+    ShmSegment segment = ShmSegment::Create(1 << 20);
+    {
+        ShmPtr<ListNode> list = MakeList(segment, 100);
+        EXPECT_TRUE(segment.Contains(list.get()));
+        EXPECT_EQ(SumList(list), 5050);
+        EXPECT_GT(segment.BytesInUse(), 0u);
+    }
+    EXPECT_EQ(segment.BytesInUse(), 0u);
+}
+
+TEST(SharedMemoryTest, SecondMappingAtAnotherAddress)
+{
+    ShmSegment segment = ShmSegment::Create(1 << 20);
+    segment.SetRoot(MakeList(segment, 10));
+
+    ShmSegment remapped = ShmSegment::Map(segment.fd());
+    ASSERT_NE(remapped.base(), segment.base());
+    ShmPtr<ListNode> root = remapped.Root<ListNode>();
+    EXPECT_TRUE(remapped.Contains(root.get()));
+    EXPECT_EQ(SumList(root), 55);
+    EXPECT_EQ(root.use_count(), 2u);
+
+    // Released through the second mapping; the blocks go back to the one allocator.
+    root.reset();
+    remapped.SetRoot(ShmPtr<ListNode>());
+    EXPECT_EQ(segment.BytesInUse(), 0u);
+}
+
+TEST(SharedMemoryTest, LastReleasingProcessReclaims)
+{
+    ShmSegment segment = ShmSegment::Create(1 << 20);
+    segment.SetRoot(MakeList(segment, 10));
+
+    const pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0)
+    {
+        ShmSegment mine = ShmSegment::Map(segment.fd());
+        ShmPtr<ListNode> root = mine.Root<ListNode>();
+        const bool intact = SumList(root) == 55;
+        root.reset();
+        mine.SetRoot(ShmPtr<ListNode>());
+        _exit(intact && mine.BytesInUse() == 0 ? 0 : 1);
+    }
+    EXPECT_EQ(WaitForChild(child), 0);
+    EXPECT_EQ(segment.BytesInUse(), 0u);
+    EXPECT_FALSE(segment.Root<ListNode>());
+}
+
+TEST(SharedMemoryTest, CountsAreSharedBetweenProcesses)
+{
+    ShmSegment segment = ShmSegment::Create(1 << 20);
+    ShmPtr<Counter> counter = MakeShm<Counter>(segment);
+    segment.SetRoot(counter);
+    const int rounds = 100000;
+
+    const pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0)
+    {
+        ShmSegment mine = ShmSegment::Map(segment.fd());
+        ShmPtr<Counter> shared = mine.Root<Counter>();
+        for (int i = 0; i < rounds; ++i)
+        {
+            ShmPtr<Counter> copy = shared;
+            copy->hits.fetch_add(1);
+        }
+        // _exit() runs no destructors.
+        shared.reset();
+        _exit(0);
+    }
+    for (int i = 0; i < rounds; ++i)
+    {
+        ShmPtr<Counter> copy = counter;
+        copy->hits.fetch_add(1);
+    }
+    EXPECT_EQ(WaitForChild(child), 0);
+    EXPECT_EQ(counter->hits.load(), 2 * rounds);
+    // The parent's pointer and the root; the child's references are gone.
+    EXPECT_EQ(counter.use_count(), 2u);
+    segment.SetRoot(ShmPtr<Counter>());
+    counter.reset();
+    EXPECT_EQ(segment.BytesInUse(), 0u);
+}
+
+TEST(SharedMemoryTest, NamedSegment)
+{
+    const char* name = "/SmartPointersNamedSegmentTest";
+    ShmSegment::RemoveNamed(name);
+    ShmSegment created = ShmSegment::CreateNamed(name, 1 << 16);
+    created.SetRoot(MakeShm<ListNode>(created, 7));
+    {
+        ShmSegment opened = ShmSegment::OpenNamed(name);
+        EXPECT_EQ(opened.Root<ListNode>()->value, 7);
+    }
+    created.SetRoot(ShmPtr<ListNode>());
+    ShmSegment::RemoveNamed(name);
+    EXPECT_EQ(created.BytesInUse(), 0u);
+}
+
+TEST(SharedMemoryTest, RejectsForeignAndShortSegments)
+{
+    EXPECT_THROW(ShmSegment::Create(8), std::invalid_argument);
+
+    for (const off_t size : {off_t{8}, off_t{1 << 16}})
+    {
+        const int fd = shm_open("/SmartPointersNotASegment", O_RDWR | O_CREAT | O_EXCL, 0600);
+        ASSERT_GE(fd, 0);
+        shm_unlink("/SmartPointersNotASegment");
+        ASSERT_EQ(ftruncate(fd, size), 0);
+        EXPECT_THROW(ShmSegment::Map(fd), std::runtime_error);
+        close(fd);
+    }
+
+    ShmSegment segment = ShmSegment::Create(1 << 16);
+    EXPECT_THROW(segment.Allocate(std::size_t{1} << 50), std::bad_alloc);
+    EXPECT_THROW(segment.Allocate(std::numeric_limits<std::size_t>::max()), std::bad_alloc);
+    EXPECT_THROW(segment.Allocate(16, 2 * ShmSegment::kBlockAlignment), std::bad_alloc);
+    EXPECT_EQ(segment.BytesInUse(), 0u);
+}
+
+TEST(SharedMemoryTest, RootIsTyped)
+{
+    ShmSegment segment = ShmSegment::Create(1 << 16);
+    segment.SetRoot(MakeShm<ListNode>(segment, 3));
+    EXPECT_THROW(segment.Root<Counter>(), std::logic_error);
+    EXPECT_THROW(segment.SetRoot(MakeShm<Counter>(segment)), std::logic_error);
+    EXPECT_EQ(segment.Root<ListNode>()->value, 3);
+
+    // Clearing with the old type frees the slot for another.
+    segment.SetRoot(ShmPtr<ListNode>());
+    segment.SetRoot(MakeShm<Counter>(segment));
+    EXPECT_EQ(segment.Root<Counter>()->hits, 0);
+    segment.SetRoot(ShmPtr<Counter>());
+    EXPECT_EQ(segment.BytesInUse(), 0u);
+}
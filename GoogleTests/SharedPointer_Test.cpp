@@ -1,6 +1,9 @@
 #include <SharedPointer.h>
 #include <gtest/gtest.h>
 
+#include <memory_resource>
+#include <thread>
+
 
 //Create by Danyil Pozniakov
 
@@ -125,8 +128,10 @@ TEST(SharedPointerTest, OperatorBool)
 TEST(SharedPointerTest, OperatorSubscript)
 {
     int* arr = new int[5]{1, 2, 3, 4, 5};
-    SharedPointer<int> p(arr);
+    SharedPointer<int[]> p(arr, 5);
     EXPECT_EQ(p[2], 3);
+    p[2] = 7;
+    EXPECT_EQ(arr[2], 7);
 }
 
 TEST(SharedPointerTest, UseCount)
@@ -200,3 +205,416 @@ TEST(SharedPointerTest, WeakPointer)
         EXPECT_TRUE(false);
     }
 }
+
+struct Left
+{
+    virtual ~Left() = default;
+    int left = 1;
+};
+
+struct Right
+{
+    virtual ~Right() = default;
+    int right = 2;
+};
+
+struct Both : Left, Right
+{
+    int both = 3;
+};
+
+TEST(SharedPointerTest, UpcastWithOffsetSharesCount)
+{
+    SharedPointer<Both> derived(new Both());
+    SharedPointer<Right> base(derived);
+    EXPECT_NE(static_cast<void*>(base.get()), static_cast<void*>(derived.get()));
+    EXPECT_EQ(base->right, 2);
+    EXPECT_EQ(derived.use_count(), 2);
+    EXPECT_EQ(base.use_count(), 2);
+
+    derived.reset();
+    EXPECT_TRUE(base.unique());
+    EXPECT_EQ(ExternalRefCounter::Instance().LiveObjects(), 1);
+    base.reset();
+    EXPECT_EQ(ExternalRefCounter::Instance().LiveObjects(), 0);
+}
+
+TEST(SharedPointerTest, AdoptBaseAddressSharesCount)
+{
+    auto* obj = new Both();
+    SharedPointer<Both> derived(obj);
+    SharedPointer<Right> base(static_cast<Right*>(obj));
+    EXPECT_EQ(derived.use_count(), 2);
+    EXPECT_EQ(ExternalRefCounter::Instance().LiveObjects(), 1);
+}
+
+TEST(SharedPointerTest, PointerCasts)
+{
+    SharedPointer<Left> base(new Both());
+
+    SharedPointer<Both> down = StaticPointerCast<Both>(base);
+    EXPECT_EQ(down->both, 3);
+    EXPECT_EQ(base.use_count(), 2);
+
+    SharedPointer<Right> cross = DynamicPointerCast<Right>(base);
+    ASSERT_TRUE(cross);
+    EXPECT_EQ(cross->right, 2);
+    EXPECT_EQ(base.use_count(), 3);
+
+    SharedPointer<Left> plain(new Left());
+    EXPECT_FALSE(DynamicPointerCast<Both>(plain));
+    EXPECT_EQ(plain.use_count(), 1);
+
+    SharedPointer<const Left> constant(base);
+    SharedPointer<Left> mutable_again = ConstPointerCast<Left>(constant);
+    EXPECT_EQ(mutable_again.get(), base.get());
+    EXPECT_EQ(base.use_count(), 5);
+}
+
+TEST(SharedPointerTest, AliasingConstructor)
+{
+    SharedPointer<Both> owner(new Both());
+    SharedPointer<int> member(owner, &owner->both);
+    EXPECT_EQ(*member, 3);
+    EXPECT_EQ(owner.use_count(), 2);
+
+    owner.reset();
+    EXPECT_EQ(*member, 3);
+    EXPECT_TRUE(member.unique());
+}
+
+TEST(SharedPointerTest, WeakPointerAfterConversion)
+{
+    SharedPointer<Both> derived(new Both());
+    WeakPointer<Right> weak(derived);
+    EXPECT_EQ(weak.use_count(), 1);
+
+    SharedPointer<Right> locked = weak.lock();
+    ASSERT_TRUE(locked);
+    EXPECT_EQ(locked->right, 2);
+    EXPECT_EQ(derived.use_count(), 2);
+
+    locked.reset();
+    derived.reset();
+    EXPECT_TRUE(weak.expired());
+    EXPECT_FALSE(weak.lock());
+}
+
+struct Counted
+{
+    Counted()
+    {
+        ++alive;
+    }
+
+    ~Counted()
+    {
+        --alive;
+    }
+
+    static inline int alive = 0;
+    int value = 42;
+};
+
+TEST(SharedPointerTest, MakeSharedArray)
+{
+    SharedPointer<int[]> numbers = MakeSharedArray<int>(1000);
+    EXPECT_EQ(numbers.size(), 1000);
+    for (int value : numbers.span())
+    {
+        EXPECT_EQ(value, 0);
+    }
+    numbers[999] = 5;
+    EXPECT_EQ(numbers.span().back(), 5);
+    EXPECT_EQ(ExternalRefCounter::Instance().LiveObjects(), 0);
+
+    {
+        SharedPointer<Counted[]> objects = MakeSharedArray<Counted>(16);
+        EXPECT_EQ(Counted::alive, 16);
+        SharedPointer<Counted[]> copy = objects;
+        EXPECT_EQ(objects.use_count(), 2);
+        EXPECT_EQ(copy[3].value, 42);
+    }
+    EXPECT_EQ(Counted::alive, 0);
+}
+
+TEST(SharedPointerTest, MakeSharedArrayAlignment)
+{
+    struct alignas(64) Line
+    {
+        char bytes[64];
+    };
+    SharedPointer<Line[]> lines = MakeSharedArrayForOverwrite<Line>(4);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(lines.get()) % 64, 0);
+    EXPECT_EQ(lines.span().size(), 4);
+}
+
+TEST(SharedPointerTest, MakeSharedArrayForOverwrite)
+{
+    SharedPointer<double[]> buffer = MakeSharedArrayForOverwrite<double>(1 << 20);
+    buffer[0] = 1.5;
+    EXPECT_EQ(buffer[0], 1.5);
+
+    SharedPointer<Counted[]> objects = MakeSharedArrayForOverwrite<Counted>(3);
+    EXPECT_EQ(Counted::alive, 3);
+    objects.reset();
+    EXPECT_EQ(Counted::alive, 0);
+    EXPECT_FALSE(objects);
+}
+
+template <class T>
+struct CountingAllocator
+{
+    using value_type = T;
+
+    explicit CountingAllocator(int* live) : live(live)
+    {
+    }
+
+    template <class U>
+    CountingAllocator(const CountingAllocator<U>& other) : live(other.live)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        ++*live;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        --*live;
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    int* live;
+};
+
+struct CountingDeleter
+{
+    void operator()(int* ptr) const
+    {
+        ++*deleted;
+        delete ptr;
+    }
+
+    int* deleted;
+};
+
+TEST(SharedPointerTest, CustomDeleter)
+{
+    int deleted = 0;
+    {
+        SharedPointer<int> p(new int(5), CountingDeleter{&deleted});
+        SharedPointer<int> copy = p;
+        EXPECT_EQ(*copy, 5);
+    }
+    EXPECT_EQ(deleted, 1);
+
+    static int stateless_deleted = 0;
+    auto stateless = [](int* ptr)
+    {
+        ++stateless_deleted;
+        delete ptr;
+    };
+    static_assert(sizeof(PointerControlBlock<int, decltype(stateless)>) == sizeof(PointerControlBlock<int>));
+    SharedPointer<int>(new int(1), stateless).reset();
+    EXPECT_EQ(stateless_deleted, 1);
+}
+
+class FailingResource : public std::pmr::memory_resource
+{
+public:
+    bool fail = false;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        if (fail)
+        {
+            throw std::bad_alloc();
+        }
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+TEST(SharedPointerTest, FailedAdoptionFreesTheObject)
+{
+    // Every allocation the registry makes once the resource is installed fails.
+    FailingResource failing;
+    ExternalRefCounter registry;
+    registry.SetMemoryResource(&failing);
+    failing.fail = true;
+
+    int deleted = 0;
+    EXPECT_THROW(SharedPointer<int>(new int(1), CountingDeleter{&deleted}, registry), std::bad_alloc);
+    EXPECT_EQ(deleted, 1);
+
+    // The plain and array overloads fall back to delete and delete[]; ASan
+    // reports a leak if they do not.
+    EXPECT_THROW(SharedPointer<int>(new int(2), registry), std::bad_alloc);
+    EXPECT_THROW(SharedPointer<int[]>(new int[4], 4, registry), std::bad_alloc);
+    EXPECT_EQ(registry.LiveObjects(), 0u);
+}
+
+TEST(SharedPointerTest, AllocateShared)
+{
+    int live = 0;
+    {
+        SharedPointer<std::string> p = AllocateShared<std::string>(CountingAllocator<std::string>(&live), "pooled");
+        EXPECT_EQ(live, 1);
+        EXPECT_EQ(*p, "pooled");
+        EXPECT_EQ(ExternalRefCounter::Instance().LiveObjects(), 0);
+
+        WeakPointer<std::string> weak(p);
+        p.reset();
+        EXPECT_TRUE(weak.expired());
+        EXPECT_EQ(live, 1);
+    }
+    EXPECT_EQ(live, 0);
+}
+
+TEST(SharedPointerTest, AllocateSharedFromMemoryResource)
+{
+    alignas(std::max_align_t) std::byte buffer[256];
+    std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+    SharedPointer<Both> p = AllocateShared<Both>(&resource);
+    SharedPointer<Right> base = p;
+    EXPECT_EQ(base->right, 2);
+    EXPECT_GE(reinterpret_cast<std::byte*>(p.get()), buffer);
+    EXPECT_LT(reinterpret_cast<std::byte*>(p.get()), buffer + sizeof(buffer));
+}
+
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    int allocations = 0;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        ++allocations;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+TEST(SharedPointerTest, RegistryMemoryResource)
+{
+    CountingResource upstream;
+    std::pmr::synchronized_pool_resource pool(&upstream);
+    ExternalRefCounter::Instance().SetMemoryResource(&pool);
+    EXPECT_EQ(ExternalRefCounter::Instance().resource(), &pool);
+
+    ExternalRefCounter::Instance().Reserve(256);
+    EXPECT_GT(upstream.allocations, 0);
+
+    // The first round allocates the map nodes; later rounds reuse everything.
+    std::vector<int> values(256);
+    int primed = 0;
+    for (int round = 0; round < 4; ++round)
+    {
+        std::vector<SharedPointer<int>> owners;
+        for (int& value : values)
+        {
+            owners.emplace_back(&value, [](int*) {});
+        }
+        EXPECT_EQ(ExternalRefCounter::Instance().LiveObjects(), values.size());
+        if (round == 0)
+        {
+            primed = upstream.allocations;
+        }
+    }
+    EXPECT_EQ(upstream.allocations, primed);
+    EXPECT_EQ(ExternalRefCounter::Instance().LiveObjects(), 0);
+
+    ExternalRefCounter::Instance().SetMemoryResource(nullptr);
+    EXPECT_NE(ExternalRefCounter::Instance().resource(), &pool);
+}
+
+struct Session : EnableSharedFromThis<Session>
+{
+    int id = 11;
+
+    SharedPointer<Session> Self()
+    {
+        return SharedFromThis();
+    }
+};
+
+TEST(SharedPointerTest, SharedFromThis)
+{
+    auto* raw = new Session();
+    EXPECT_TRUE(raw->WeakFromThis().expired());
+
+    SharedPointer<Session> owner(raw);
+    SharedPointer<Session> self = raw->Self();
+    EXPECT_EQ(self.get(), raw);
+    EXPECT_EQ(owner.use_count(), 2);
+
+    const Session& constant = *owner;
+    SharedPointer<const Session> const_self = constant.SharedFromThis();
+    EXPECT_EQ(const_self->id, 11);
+    EXPECT_EQ(owner.use_count(), 3);
+
+    WeakPointer<Session> weak = raw->WeakFromThis();
+    self.reset();
+    const_self.reset();
+    owner.reset();
+    EXPECT_TRUE(weak.expired());
+}
+
+TEST(SharedPointerTest, SharedFromThisWithoutRegistry)
+{
+    SharedPointer<Session> allocated = AllocateShared<Session>(std::allocator<Session>());
+    EXPECT_EQ(allocated->Self().get(), allocated.get());
+
+    SharedPointer<Session> converted(MakeUnique<Session>());
+    EXPECT_EQ(converted->Self().use_count(), 2);
+
+    Session copy = *converted;
+    EXPECT_TRUE(copy.WeakFromThis().expired());
+}
+
+TEST(SharedPointerTest, SharedFromThisConcurrent)
+{
+    SharedPointer<Session> owner = AllocateShared<Session>(std::allocator<Session>());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&owner]
+        {
+            for (int i = 0; i < 10000; ++i)
+            {
+                SharedPointer<Session> self = owner->SharedFromThis();
+                ASSERT_EQ(self.get(), owner.get());
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT_TRUE(owner.unique());
+}
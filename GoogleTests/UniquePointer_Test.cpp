@@ -0,0 +1,220 @@
+#include <UniquePointer.h>
+#include <IntrusivePtr.h>
+#include <SharedPointer.h>
+#include <gtest/gtest.h>
+
+#include <memory_resource>
+#include <new>
+#include <string>
+
+
+struct Counted
+{
+    Counted()
+    {
+        ++alive;
+    }
+
+    virtual ~Counted()
+    {
+        --alive;
+    }
+
+    static inline int alive = 0;
+    int value = 4;
+};
+
+struct DerivedCounted : Counted
+{
+    int extra = 5;
+};
+
+struct CountingDeleter
+{
+    void operator()(Counted* ptr) const
+    {
+        ++deleted;
+        delete ptr;
+    }
+
+    static inline int deleted = 0;
+};
+
+class IntrusiveCounted : public RefCounter
+{
+public:
+    explicit IntrusiveCounted(bool* destroyed) : destroyed(destroyed)
+    {
+    }
+
+    ~IntrusiveCounted() override
+    {
+        *destroyed = true;
+    }
+
+    bool* destroyed;
+};
+
+TEST(UniquePointerTest, PointerSized)
+{
+    static_assert(sizeof(UniquePointer<int>) == sizeof(int*));
+    static_assert(sizeof(UniquePointer<int[]>) == sizeof(int*));
+    static_assert(sizeof(UniquePointer<Counted, CountingDeleter>) == sizeof(Counted*));
+    static_assert(!std::is_copy_constructible_v<UniquePointer<int>>);
+}
+
+TEST(UniquePointerTest, OwnsAndReleases)
+{
+    {
+        UniquePointer<Counted> p = MakeUnique<Counted>();
+        EXPECT_EQ(Counted::alive, 1);
+        EXPECT_EQ(p->value, 4);
+
+        UniquePointer<Counted> moved = std::move(p);
+        EXPECT_FALSE(p);
+        EXPECT_TRUE(moved);
+
+        Counted* raw = moved.release();
+        EXPECT_FALSE(moved);
+        moved.reset(raw);
+    }
+    EXPECT_EQ(Counted::alive, 0);
+}
+
+TEST(UniquePointerTest, ConvertsToBase)
+{
+    UniquePointer<DerivedCounted> derived = MakeUnique<DerivedCounted>();
+    UniquePointer<Counted> base = std::move(derived);
+    EXPECT_EQ(base->value, 4);
+    base.reset();
+    EXPECT_EQ(Counted::alive, 0);
+}
+
+TEST(UniquePointerTest, Array)
+{
+    UniquePointer<int[]> numbers = MakeUniqueArray<int>(8);
+    EXPECT_EQ(numbers[7], 0);
+    numbers[3] = 6;
+    EXPECT_EQ(numbers.get()[3], 6);
+
+    {
+        UniquePointer<Counted[]> objects(new Counted[3]);
+        EXPECT_EQ(Counted::alive, 3);
+    }
+    EXPECT_EQ(Counted::alive, 0);
+}
+
+TEST(UniquePointerTest, IntoSharedPointer)
+{
+    const std::size_t registered = ExternalRefCounter::Instance().LiveObjects();
+    CountingDeleter::deleted = 0;
+    {
+        UniquePointer<DerivedCounted, CountingDeleter> unique(new DerivedCounted());
+        SharedPointer<Counted> shared(std::move(unique));
+        EXPECT_FALSE(unique);
+        EXPECT_TRUE(shared.unique());
+        EXPECT_EQ(shared->value, 4);
+        EXPECT_EQ(ExternalRefCounter::Instance().LiveObjects(), registered);
+
+        SharedPointer<Counted> copy = shared;
+        EXPECT_EQ(copy.use_count(), 2);
+    }
+    EXPECT_EQ(CountingDeleter::deleted, 1);
+    EXPECT_EQ(Counted::alive, 0);
+
+    SharedPointer<std::string> empty{UniquePointer<std::string>()};
+    EXPECT_FALSE(empty);
+}
+
+struct TaggedDeleter
+{
+    void operator()(Counted* ptr) const
+    {
+        last_tag = tag;
+        delete ptr;
+    }
+
+    std::string tag = "tagged deleter";
+    static inline std::string last_tag;
+};
+
+class FailingResource : public std::pmr::memory_resource
+{
+public:
+    bool fail = false;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        if (fail)
+        {
+            throw std::bad_alloc();
+        }
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+TEST(UniquePointerTest, FailedConversionKeepsTheDeleter)
+{
+    FailingResource resource;
+    ExternalRefCounter::Instance().SetMemoryResource(&resource);
+    UniquePointer<Counted, TaggedDeleter> unique(new Counted());
+    resource.fail = true;
+    EXPECT_THROW(SharedPointer<Counted>{std::move(unique)}, std::bad_alloc);
+    resource.fail = false;
+    ExternalRefCounter::Instance().SetMemoryResource(nullptr);
+
+    ASSERT_TRUE(unique);
+    unique.reset();
+    EXPECT_EQ(TaggedDeleter::last_tag, "tagged deleter");
+    EXPECT_EQ(Counted::alive, 0);
+}
+
+TEST(UniquePointerTest, ArrayIntoSharedPointer)
+{
+    const std::size_t registered = ExternalRefCounter::Instance().LiveObjects();
+    {
+        UniquePointer<Counted[]> unique(new Counted[4]);
+        Counted* elements = unique.get();
+        SharedPointer<Counted[]> shared(std::move(unique), 4);
+        EXPECT_FALSE(unique);
+        EXPECT_EQ(shared.get(), elements);
+        EXPECT_EQ(shared.size(), 4u);
+        EXPECT_EQ(shared[3].value, 4);
+        EXPECT_EQ(ExternalRefCounter::Instance().LiveObjects(), registered);
+
+        SharedPointer<Counted[]> copy = shared;
+        shared.reset();
+        EXPECT_EQ(Counted::alive, 4);
+    }
+    EXPECT_EQ(Counted::alive, 0);
+
+    SharedPointer<int[]> empty(UniquePointer<int[]>(), 0);
+    EXPECT_FALSE(empty);
+}
+
+TEST(UniquePointerTest, IntoIntrusivePtr)
+{
+    bool destroyed = false;
+    UniquePointer<IntrusiveCounted> unique = MakeUnique<IntrusiveCounted>(&destroyed);
+    IntrusivePtr<IntrusiveCounted> p(std::move(unique));
+    EXPECT_FALSE(unique);
+#ifdef _DEBUG
+    EXPECT_EQ(p->GetRefCount(), 1);
+#endif
+    IntrusivePtr<IntrusiveCounted> copy = p;
+    p.reset();
+    EXPECT_FALSE(destroyed);
+    copy.reset();
+    EXPECT_TRUE(destroyed);
+}
@@ -0,0 +1,165 @@
+#include <WeakValueCache.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct Resource
+{
+    explicit Resource(int id) : id(id)
+    {
+    }
+
+    int id;
+};
+
+
+TEST(WeakValueCacheTest, HitReturnsLiveValue)
+{
+    int loads = 0;
+    WeakValueCache<int, Resource> cache([&loads](const int& key)
+    {
+        ++loads;
+        return MakeUnique<Resource>(key);
+    });
+
+    SharedPointer<Resource> a = cache.Get(1);
+    SharedPointer<Resource> b = cache.Get(1);
+    EXPECT_EQ(a.get(), b.get());
+    EXPECT_EQ(a->id, 1);
+    EXPECT_EQ(loads, 1);
+    EXPECT_EQ(cache.Find(1).get(), a.get());
+    EXPECT_FALSE(cache.Find(2));
+    EXPECT_EQ(cache.size(), 1u);
+}
+
+TEST(WeakValueCacheTest, LastReleaseDropsEntry)
+{
+    int loads = 0;
+    WeakValueCache<std::string, Resource> cache([&loads](const std::string& key)
+    {
+        ++loads;
+        return MakeUnique<Resource>(static_cast<int>(key.size()));
+    });
+
+    SharedPointer<Resource> a = cache.Get("abc");
+    EXPECT_EQ(cache.size(), 1u);
+    a.reset();
+    EXPECT_EQ(cache.size(), 0u);
+
+    SharedPointer<Resource> b = cache.Get("abc");
+    EXPECT_EQ(b->id, 3);
+    EXPECT_EQ(loads, 2);
+}
+
+TEST(WeakValueCacheTest, NullLoadIsNotCached)
+{
+    WeakValueCache<int, Resource> cache([](const int&)
+    {
+        return UniquePointer<Resource>();
+    });
+    EXPECT_FALSE(cache.Get(1));
+    EXPECT_EQ(cache.size(), 0u);
+}
+
+TEST(WeakValueCacheTest, ConcurrentMissesLoadOnce)
+{
+    std::atomic_int loads = 0;
+    WeakValueCache<int, Resource> cache([&loads](const int& key)
+    {
+        ++loads;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return MakeUnique<Resource>(key);
+    });
+
+    const int thread_count = 8;
+    std::vector<SharedPointer<Resource>> results(thread_count);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t)
+    {
+        threads.emplace_back([&cache, &results, t]
+        {
+            results[t] = cache.Get(42);
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT_EQ(loads.load(), 1);
+    for (const auto& result : results)
+    {
+        EXPECT_EQ(result.get(), results[0].get());
+    }
+}
+
+TEST(WeakValueCacheTest, LoaderExceptionReachesEveryWaiter)
+{
+    std::atomic_int loads = 0;
+    WeakValueCache<int, Resource> cache([&loads](const int& key) -> UniquePointer<Resource>
+    {
+        if (loads++ == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            throw std::runtime_error("load failed");
+        }
+        return MakeUnique<Resource>(key);
+    });
+
+    std::atomic_int failures = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&cache, &failures]
+        {
+            try
+            {
+                cache.Get(7);
+            }
+            catch (const std::runtime_error&)
+            {
+                ++failures;
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    // Threads that arrived after the failed load was cleaned up load again
+    // or hit a value loaded by one of them.
+    EXPECT_GE(failures.load(), 1);
+    EXPECT_LE(failures.load() + loads.load() - 1, 4);
+    EXPECT_EQ(cache.Get(7)->id, 7);
+}
+
+TEST(WeakValueCacheTest, ConcurrentGetAndRelease)
+{
+    WeakValueCache<int, Resource> cache([](const int& key)
+    {
+        return MakeUnique<Resource>(key);
+    });
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t)
+    {
+        threads.emplace_back([&cache]
+        {
+            for (int round = 0; round < 20000; ++round)
+            {
+                SharedPointer<Resource> value = cache.Get(round % 8);
+                ASSERT_EQ(value->id, round % 8);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT_EQ(cache.size(), 0u);
+}
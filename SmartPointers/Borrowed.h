@@ -0,0 +1,187 @@
+#ifndef BORROWED_H
+#define BORROWED_H
+
+#include <assert.h>
+#include <type_traits>
+
+#include "IntrusivePtr.h"
+#include "SharedPointer.h"
+
+// Non-owning references for passing objects down a call stack without count
+// traffic. IntrusiveRef is a plain pointer; Borrowed also keeps the control
+// block, so that it can be promoted without a lookup. In _DEBUG builds both
+// register themselves as borrows of the object, and the final release asserts
+// if the object dies while any borrow is still outstanding. The layout is the
+// same in every build. Neither can be made from a temporary owner, which
+// would leave the borrow dangling at once.
+
+
+//INTRUSIVE REF
+// Borrow of a RefCounter object. Promote() turns it back into an owner with a
+// single AddRef, which is always valid while the borrow is.
+template <class Type>
+class IntrusiveRef
+{
+public:
+    IntrusiveRef(const IntrusivePtr<Type>& owner) noexcept : pointer_(owner.get())
+    {
+        assert(pointer_ && "IntrusiveRef borrowed from an empty pointer");
+        Borrow();
+    }
+
+    IntrusiveRef(IntrusivePtr<Type>&&) = delete;
+
+    IntrusiveRef(const IntrusiveRef& other) noexcept : pointer_(other.pointer_)
+    {
+        Borrow();
+    }
+
+    IntrusiveRef& operator=(const IntrusiveRef& other) noexcept
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        Return();
+        pointer_ = other.pointer_;
+        Borrow();
+        return *this;
+    }
+
+    ~IntrusiveRef()
+    {
+        Return();
+    }
+
+    Type* operator->() const noexcept
+    {
+        return pointer_;
+    }
+
+    Type& operator*() const noexcept
+    {
+        return *pointer_;
+    }
+
+    Type* get() const noexcept
+    {
+        return pointer_;
+    }
+
+    [[nodiscard]] IntrusivePtr<Type> Promote() const
+    {
+        return IntrusivePtr<Type>(pointer_);
+    }
+
+private:
+    void Borrow() noexcept
+    {
+#ifdef _DEBUG
+        static_cast<RefCounter*>(pointer_)->borrow_count.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    void Return() noexcept
+    {
+#ifdef _DEBUG
+        static_cast<RefCounter*>(pointer_)->borrow_count.fetch_sub(1, std::memory_order_relaxed);
+#endif
+    }
+
+    Type* pointer_;
+};
+
+
+//BORROWED
+// Borrow of a SharedPointer-owned object. Promote() adds a strong reference
+// through the owner's control block, however the object was created.
+//
+// Unlike IntrusiveRef this is two pointers wide, not one. The control block
+// cannot be recovered from the object pointer alone: objects from
+// AllocateShared and UniquePointer are never entered in the registry, only
+// EnableSharedFromThis types carry a link back to their block, and a
+// converted owner points at a base subobject rather than the object the block
+// was made for. Keeping the block next to the pointer is what lets Promote()
+// work for every owner without a lookup.
+template <class Type>
+class Borrowed
+{
+public:
+    Borrowed(const SharedPointer<Type>& owner) noexcept : pointer_(owner.get()), control_(owner.control_)
+    {
+        assert(pointer_ && "Borrowed from an empty pointer");
+        Borrow();
+    }
+
+    Borrowed(SharedPointer<Type>&&) = delete;
+
+    Borrowed(const Borrowed& other) noexcept : pointer_(other.pointer_), control_(other.control_)
+    {
+        Borrow();
+    }
+
+    Borrowed& operator=(const Borrowed& other) noexcept
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        Return();
+        pointer_ = other.pointer_;
+        control_ = other.control_;
+        Borrow();
+        return *this;
+    }
+
+    ~Borrowed()
+    {
+        Return();
+    }
+
+    Type* operator->() const noexcept
+    {
+        return pointer_;
+    }
+
+    Type& operator*() const noexcept
+    {
+        return *pointer_;
+    }
+
+    Type* get() const noexcept
+    {
+        return pointer_;
+    }
+
+    // An owner outlives every borrow, so the count is never zero here; the
+    // CAS only guards against a borrow that is already dangling.
+    [[nodiscard]] SharedPointer<Type> Promote() const
+    {
+        if (!control_->TryAddRef())
+        {
+            return SharedPointer<Type>();
+        }
+        SP_INSTRUMENT(Type, AddRef);
+        return SharedPointer<Type>(pointer_, control_, typename SharedPointer<Type>::AdoptTag{});
+    }
+
+private:
+    void Borrow() noexcept
+    {
+#ifdef _DEBUG
+        control_->borrows.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    void Return() noexcept
+    {
+#ifdef _DEBUG
+        control_->borrows.fetch_sub(1, std::memory_order_relaxed);
+#endif
+    }
+
+    Type* pointer_;
+    SharedControlBlock* control_;
+};
+
+#endif //BORROWED_H
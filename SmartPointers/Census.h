@@ -0,0 +1,384 @@
+#ifndef CENSUS_H
+#define CENSUS_H
+
+#include <ostream>
+
+// Live-object census for IntrusivePtr- and SharedPointer-managed objects.
+//
+// Enabled by defining SMARTPOINTERS_CENSUS (CMake option of the same name).
+// Every managed object is counted by pointee type when it gets its first owner
+// and uncounted when the last owner destroys it: two relaxed atomic updates per
+// object lifetime. Polymorphic objects are counted by their dynamic type, so an
+// object created through IntrusivePtr<Derived> and released through
+// IntrusivePtr<Base>, or adopted by SharedPointer<Base>, stays on Derived's
+// row. Their size is exact once one has been owned through a pointer to its
+// own type; until then it is the largest static type seen.
+//
+// Every Nth creation (SetSampleInterval) also captures the creation call
+// stack, which is kept until the object dies, so ReportLeaks() can show where
+// surviving objects came from.
+//
+// SharedPointer<T[]> arrays are not counted: a row has one object size, and
+// an array's footprint depends on its length. They do not appear in Snapshot()
+// or ReportLeaks().
+//
+// Without SMARTPOINTERS_CENSUS the SP_CENSUS_* macros expand to nothing.
+
+#ifdef SMARTPOINTERS_CENSUS
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define SMARTPOINTERS_CENSUS_BACKTRACE 1
+#endif
+
+namespace Census
+{
+    struct TypeCensus
+    {
+        std::string name;
+        std::size_t object_size = 0;
+        std::uint64_t live = 0;
+        std::uint64_t created = 0;
+
+        [[nodiscard]] std::uint64_t live_bytes() const
+        {
+            return live * object_size;
+        }
+    };
+
+    struct SampledObject
+    {
+        const void* address = nullptr;
+        std::string type;
+        std::vector<void*> frames;
+    };
+
+    class Registry
+    {
+    public:
+        struct Entry
+        {
+            const char* name = nullptr;
+            std::atomic<std::size_t> object_size = 0;
+            std::atomic<std::uint64_t> live = 0;
+            std::atomic<std::uint64_t> created = 0;
+        };
+
+        static Registry& Instance()
+        {
+            static Registry registry;
+            return registry;
+        }
+
+        Entry& Register(const std::type_info& type)
+        {
+            // Hooks run on every creation and final release; after the first
+            // lookup of a type a thread finds its entry without the lock. The
+            // direct-mapped cache has no destructor, so releases made from
+            // other thread_local destructors at thread exit can still use it.
+            struct CachedType
+            {
+                const std::type_info* type = nullptr;
+                Entry* entry = nullptr;
+            };
+            static thread_local std::array<CachedType, 16> cache{};
+            CachedType& cached = cache[std::hash<const void*>{}(&type) % cache.size()];
+            if (cached.type == &type)
+            {
+                return *cached.entry;
+            }
+            std::lock_guard lock(mutex_);
+            Entry*& entry = by_type_[std::type_index(type)];
+            if (entry == nullptr)
+            {
+                entry = &entries_.emplace_back();
+                entry->name = type.name();
+            }
+            cached = {&type, entry};
+            return *entry;
+        }
+
+        // Exact sizes replace estimates; estimates only grow.
+        static void NoteSize(Entry& entry, std::size_t size, bool exact)
+        {
+            std::size_t known = entry.object_size.load(std::memory_order_relaxed);
+            if (exact)
+            {
+                if (known != size)
+                {
+                    entry.object_size.store(size, std::memory_order_relaxed);
+                }
+                return;
+            }
+            while (known < size && !entry.object_size.compare_exchange_weak(known, size, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        void SetSampleInterval(std::uint32_t interval)
+        {
+            sample_interval_.store(interval, std::memory_order_relaxed);
+        }
+
+        void OnCreated(Entry& entry, const void* address)
+        {
+            entry.live.fetch_add(1, std::memory_order_relaxed);
+            entry.created.fetch_add(1, std::memory_order_relaxed);
+            if (ShouldSample())
+            {
+                CaptureStack(entry, address);
+            }
+        }
+
+        void OnDestroyed(Entry& entry, const void* address)
+        {
+            entry.live.fetch_sub(1, std::memory_order_relaxed);
+            // Most objects were never sampled: the filter rejects them without a lock.
+            if (filter_[FilterSlot(address)].load(std::memory_order_relaxed) == 0)
+            {
+                return;
+            }
+            std::lock_guard lock(mutex_);
+            if (samples_.erase(address) != 0)
+            {
+                filter_[FilterSlot(address)].fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        [[nodiscard]] std::vector<TypeCensus> Snapshot()
+        {
+            std::lock_guard lock(mutex_);
+            std::vector<TypeCensus> census;
+            census.reserve(entries_.size());
+            for (const Entry& entry : entries_)
+            {
+                census.push_back({entry.name, entry.object_size.load(std::memory_order_relaxed),
+                                  entry.live.load(std::memory_order_relaxed),
+                                  entry.created.load(std::memory_order_relaxed)});
+            }
+            std::sort(census.begin(), census.end(), [](const TypeCensus& a, const TypeCensus& b)
+            {
+                return a.live_bytes() > b.live_bytes();
+            });
+            return census;
+        }
+
+        [[nodiscard]] std::vector<SampledObject> LiveSamples()
+        {
+            std::lock_guard lock(mutex_);
+            std::vector<SampledObject> samples;
+            samples.reserve(samples_.size());
+            for (const auto& [address, sample] : samples_)
+            {
+                samples.push_back({address, sample.entry->name, sample.frames});
+            }
+            return samples;
+        }
+
+    private:
+        struct Sample
+        {
+            const Entry* entry = nullptr;
+            std::vector<void*> frames;
+        };
+
+        static constexpr std::size_t kFilterSlots = 4096;
+        static constexpr int kMaxFrames = 32;
+
+        Registry() = default;
+
+        static std::size_t FilterSlot(const void* address)
+        {
+            return std::hash<const void*>{}(address) % kFilterSlots;
+        }
+
+        bool ShouldSample()
+        {
+            const std::uint32_t interval = sample_interval_.load(std::memory_order_relaxed);
+            if (interval == 0)
+            {
+                return false;
+            }
+            static thread_local std::uint32_t countdown = 0;
+            if (countdown == 0 || countdown > interval)
+            {
+                countdown = interval;
+            }
+            return --countdown == 0;
+        }
+
+        void CaptureStack(const Entry& entry, const void* address)
+        {
+            Sample sample{&entry, {}};
+#ifdef SMARTPOINTERS_CENSUS_BACKTRACE
+            sample.frames.resize(kMaxFrames);
+            sample.frames.resize(static_cast<std::size_t>(backtrace(sample.frames.data(), kMaxFrames)));
+#endif
+            std::lock_guard lock(mutex_);
+            if (samples_.insert_or_assign(address, std::move(sample)).second)
+            {
+                filter_[FilterSlot(address)].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        std::mutex mutex_;
+        std::deque<Entry> entries_;
+        std::unordered_map<std::type_index, Entry*> by_type_;
+        std::atomic<std::uint32_t> sample_interval_ = 1024;
+        std::unordered_map<const void*, Sample> samples_;
+        std::array<std::atomic<std::uint32_t>, kFilterSlots> filter_{};
+    };
+
+    template <class Type>
+    Registry::Entry& EntryFor()
+    {
+        static Registry::Entry& entry = []() -> Registry::Entry&
+        {
+            Registry::Entry& registered = Registry::Instance().Register(typeid(Type));
+            Registry::NoteSize(registered, sizeof(Type), true);
+            return registered;
+        }();
+        return entry;
+    }
+
+    // Polymorphic objects, counted by dynamic type. Type is the static type of
+    // the pointer that gave the object its first owner.
+    template <class Type>
+    void OnObjectCreated(const Type* object)
+    {
+        const std::type_info& type = typeid(*object);
+        Registry::Entry& entry = Registry::Instance().Register(type);
+        Registry::NoteSize(entry, sizeof(Type), type == typeid(Type));
+        Registry::Instance().OnCreated(entry, object);
+    }
+
+    // Must run while the object is still alive.
+    template <class Type>
+    void OnObjectDestroyed(const Type* object)
+    {
+        Registry::Instance().OnDestroyed(Registry::Instance().Register(typeid(*object)), object);
+    }
+
+    // Objects whose owner knows only their static type. Polymorphic ones still
+    // go by their dynamic type.
+    template <class Type>
+    void OnCreated(const Type* object)
+    {
+        if constexpr (std::is_polymorphic_v<Type>)
+        {
+            OnObjectCreated(object);
+        }
+        else
+        {
+            Registry::Instance().OnCreated(EntryFor<Type>(), object);
+        }
+    }
+
+    // Must run while the object is still alive.
+    template <class Type>
+    void OnDestroyed(const Type* object)
+    {
+        if constexpr (std::is_polymorphic_v<Type>)
+        {
+            OnObjectDestroyed(object);
+        }
+        else
+        {
+            Registry::Instance().OnDestroyed(EntryFor<Type>(), object);
+        }
+    }
+
+    // Capture the creation stack of every Nth object (per thread); 0 disables sampling.
+    inline void SetSampleInterval(std::uint32_t interval)
+    {
+        Registry::Instance().SetSampleInterval(interval);
+    }
+
+    // Live objects by type, largest live footprint first.
+    inline std::vector<TypeCensus> Snapshot()
+    {
+        return Registry::Instance().Snapshot();
+    }
+
+    inline std::vector<SampledObject> LiveSamples()
+    {
+        return Registry::Instance().LiveSamples();
+    }
+
+    inline void ReportLeaks(std::ostream& out)
+    {
+        std::uint64_t leaked = 0;
+        for (const TypeCensus& type : Snapshot())
+        {
+            if (type.live == 0)
+            {
+                continue;
+            }
+            leaked += type.live;
+            out << type.name << ": " << type.live << " live, " << type.live_bytes()
+                << " bytes (" << type.created << " created)\n";
+        }
+        if (leaked == 0)
+        {
+            out << "No live objects\n";
+            return;
+        }
+        for (const SampledObject& sample : LiveSamples())
+        {
+            out << "  " << sample.type << " at " << sample.address << " created at:\n";
+#ifdef SMARTPOINTERS_CENSUS_BACKTRACE
+            char** symbols = backtrace_symbols(sample.frames.data(), static_cast<int>(sample.frames.size()));
+            for (std::size_t i = 0; symbols != nullptr && i < sample.frames.size(); ++i)
+            {
+                out << "    " << symbols[i] << '\n';
+            }
+            std::free(symbols);
+#endif
+        }
+    }
+
+    // Prints ReportLeaks() to stderr when the process exits normally.
+    inline void EnableLeakReportAtExit()
+    {
+        // Construct the registry first so it is destroyed after the handler runs.
+        Registry::Instance();
+        static std::once_flag registered;
+        std::call_once(registered, []
+        {
+            std::atexit([] { ReportLeaks(std::cerr); });
+        });
+    }
+}
+
+#define SP_CENSUS_CREATED(Type, object) ::Census::OnCreated<Type>(object)
+#define SP_CENSUS_DESTROYED(Type, object) ::Census::OnDestroyed<Type>(object)
+#define SP_CENSUS_OBJECT_CREATED(object) ::Census::OnObjectCreated(object)
+#define SP_CENSUS_OBJECT_DESTROYED(object) ::Census::OnObjectDestroyed(object)
+
+#else
+
+#define SP_CENSUS_CREATED(Type, object) ((void)0)
+#define SP_CENSUS_DESTROYED(Type, object) ((void)0)
+#define SP_CENSUS_OBJECT_CREATED(object) ((void)0)
+#define SP_CENSUS_OBJECT_DESTROYED(object) ((void)0)
+
+#endif //SMARTPOINTERS_CENSUS
+
+#endif //CENSUS_H
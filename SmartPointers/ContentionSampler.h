@@ -0,0 +1,290 @@
+#ifndef CONTENTIONSAMPLER_H
+#define CONTENTIONSAMPLER_H
+
+#include <cstddef>
+#include <ostream>
+
+// Sampling profiler for reference-count contention.
+//
+// Enabled by defining SMARTPOINTERS_CONTENTION_SAMPLING (CMake option of the
+// same name). Every count RMW in RefCounter and SharedPointer is timed; the
+// operation is recorded when it is the Nth on its thread or when it took longer
+// than the slow threshold (a contended cache line shows up as a slow RMW).
+// Records go into a fixed lock-free ring buffer that keeps the newest samples,
+// and Report() ranks the sampled objects by estimated contention so the hottest
+// shared objects can be made immortal or sharded.
+//
+// Without SMARTPOINTERS_CONTENTION_SAMPLING the SP_CONTENTION_* macros expand to nothing.
+
+#ifdef SMARTPOINTERS_CONTENTION_SAMPLING
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <typeinfo>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <x86intrin.h>
+#endif
+
+namespace ContentionSampler
+{
+    enum class Operation : std::uint8_t
+    {
+        AddRef,
+        Release
+    };
+
+    struct Sample
+    {
+        const void* address = nullptr;
+        const char* type = nullptr;
+        std::uint64_t thread = 0;
+        std::uint64_t ticks = 0;
+        Operation operation = Operation::AddRef;
+        bool slow = false;
+    };
+
+    struct ObjectContention
+    {
+        const void* address = nullptr;
+        const char* type = nullptr;
+        std::uint64_t samples = 0;
+        std::uint64_t slow_samples = 0;
+        std::uint64_t total_ticks = 0;
+        std::size_t threads = 0;
+
+        // Time spent in sampled RMWs, weighted by how many threads touched the line.
+        [[nodiscard]] double score() const
+        {
+            return static_cast<double>(total_ticks) * static_cast<double>(threads);
+        }
+    };
+
+    inline std::uint64_t Now()
+    {
+#if defined(__x86_64__) || defined(_M_X64)
+        return __rdtsc();
+#else
+        return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    // Multi-producer ring of the newest kCapacity samples. A writer claims a slot
+    // with one fetch_add and publishes it with a per-slot sequence number, so a
+    // reader can detect and skip slots that are being overwritten.
+    class RingBuffer
+    {
+    public:
+        static constexpr std::size_t kCapacity = 1 << 14;
+
+        static RingBuffer& Instance()
+        {
+            static RingBuffer ring;
+            return ring;
+        }
+
+        void Push(const Sample& sample)
+        {
+            const std::uint64_t ticket = head_.fetch_add(1, std::memory_order_relaxed);
+            Slot& slot = slots_[ticket % kCapacity];
+            slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.address.store(sample.address, std::memory_order_relaxed);
+            slot.type.store(sample.type, std::memory_order_relaxed);
+            slot.thread.store(sample.thread, std::memory_order_relaxed);
+            slot.ticks.store(sample.ticks, std::memory_order_relaxed);
+            slot.flags.store(static_cast<std::uint8_t>(sample.operation) | (sample.slow ? 2u : 0u),
+                             std::memory_order_relaxed);
+            slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+        }
+
+        [[nodiscard]] std::vector<Sample> Drain()
+        {
+            std::vector<Sample> samples;
+            samples.reserve(kCapacity);
+            for (Slot& slot : slots_)
+            {
+                const std::uint64_t before = slot.sequence.load(std::memory_order_acquire);
+                if (before == 0 || before % 2 == 1)
+                {
+                    continue;
+                }
+                Sample sample;
+                sample.address = slot.address.load(std::memory_order_relaxed);
+                sample.type = slot.type.load(std::memory_order_relaxed);
+                sample.thread = slot.thread.load(std::memory_order_relaxed);
+                sample.ticks = slot.ticks.load(std::memory_order_relaxed);
+                const std::uint8_t flags = slot.flags.load(std::memory_order_relaxed);
+                sample.operation = static_cast<Operation>(flags & 1u);
+                sample.slow = (flags & 2u) != 0;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) == before)
+                {
+                    samples.push_back(sample);
+                }
+            }
+            return samples;
+        }
+
+        void Clear()
+        {
+            for (Slot& slot : slots_)
+            {
+                slot.sequence.store(0, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        struct Slot
+        {
+            std::atomic<std::uint64_t> sequence = 0;
+            std::atomic<const void*> address = nullptr;
+            std::atomic<const char*> type = nullptr;
+            std::atomic<std::uint64_t> thread = 0;
+            std::atomic<std::uint64_t> ticks = 0;
+            std::atomic<std::uint8_t> flags = 0;
+        };
+
+        RingBuffer() = default;
+
+        alignas(64) std::atomic<std::uint64_t> head_ = 0;
+        std::array<Slot, kCapacity> slots_{};
+    };
+
+    struct Settings
+    {
+        std::atomic<std::uint32_t> every_nth = 1024;
+        std::atomic<std::uint64_t> slow_ticks = 2000;
+    };
+
+    inline Settings& GetSettings()
+    {
+        static Settings settings;
+        return settings;
+    }
+
+    // Record every Nth RMW per thread (0 disables periodic sampling) and every RMW
+    // slower than slow_ticks timestamp ticks (0 disables slow detection).
+    inline void Configure(std::uint32_t every_nth, std::uint64_t slow_ticks)
+    {
+        GetSettings().every_nth.store(every_nth, std::memory_order_relaxed);
+        GetSettings().slow_ticks.store(slow_ticks, std::memory_order_relaxed);
+    }
+
+    struct Timing
+    {
+        // Read before the RMW: once a Release has decremented, another thread
+        // may free the object, so its dynamic type cannot be looked up afterwards.
+        const char* type = nullptr;
+        std::uint64_t start = 0;
+        std::uint64_t elapsed = 0;
+        bool slow = false;
+    };
+
+    inline Timing Begin(const char* type)
+    {
+        return Timing{type, Now()};
+    }
+
+    inline bool ShouldRecord(Timing& timing)
+    {
+        timing.elapsed = Now() - timing.start;
+        const std::uint64_t slow_ticks = GetSettings().slow_ticks.load(std::memory_order_relaxed);
+        timing.slow = slow_ticks != 0 && timing.elapsed >= slow_ticks;
+
+        const std::uint32_t every_nth = GetSettings().every_nth.load(std::memory_order_relaxed);
+        static thread_local std::uint32_t countdown = 0;
+        bool periodic = false;
+        if (every_nth != 0)
+        {
+            if (countdown == 0 || countdown > every_nth)
+            {
+                countdown = every_nth;
+            }
+            periodic = --countdown == 0;
+        }
+        return periodic || timing.slow;
+    }
+
+    inline void Record(const Timing& timing, const void* address, Operation operation)
+    {
+        static thread_local const std::uint64_t thread =
+            std::hash<std::thread::id>{}(std::this_thread::get_id());
+        RingBuffer::Instance().Push({address, timing.type, thread, timing.elapsed, operation, timing.slow});
+    }
+
+    // Sampled objects ranked by estimated contention, hottest first.
+    inline std::vector<ObjectContention> Report()
+    {
+        std::unordered_map<const void*, ObjectContention> objects;
+        std::unordered_map<const void*, std::unordered_set<std::uint64_t>> threads;
+        for (const Sample& sample : RingBuffer::Instance().Drain())
+        {
+            ObjectContention& object = objects[sample.address];
+            object.address = sample.address;
+            object.type = sample.type;
+            ++object.samples;
+            object.slow_samples += sample.slow ? 1 : 0;
+            object.total_ticks += sample.ticks;
+            threads[sample.address].insert(sample.thread);
+        }
+
+        std::vector<ObjectContention> ranked;
+        ranked.reserve(objects.size());
+        for (auto& [address, object] : objects)
+        {
+            object.threads = threads[address].size();
+            ranked.push_back(object);
+        }
+        std::sort(ranked.begin(), ranked.end(), [](const ObjectContention& a, const ObjectContention& b)
+        {
+            return a.score() > b.score();
+        });
+        return ranked;
+    }
+
+    inline void PrintReport(std::ostream& out, std::size_t top = 20)
+    {
+        const auto ranked = Report();
+        out << "address type samples slow threads total_ticks\n";
+        for (std::size_t i = 0; i < ranked.size() && i < top; ++i)
+        {
+            const ObjectContention& object = ranked[i];
+            out << object.address << ' ' << object.type << ' ' << object.samples << ' '
+                << object.slow_samples << ' ' << object.threads << ' ' << object.total_ticks << '\n';
+        }
+    }
+
+    inline void Reset()
+    {
+        RingBuffer::Instance().Clear();
+    }
+}
+
+#define SP_CONTENTION_BEGIN(timing, type_name) \
+    ::ContentionSampler::Timing timing = ::ContentionSampler::Begin(type_name)
+#define SP_CONTENTION_END(timing, address, operation)                                              \
+    do                                                                                             \
+    {                                                                                              \
+        if (::ContentionSampler::ShouldRecord(timing))                                             \
+        {                                                                                          \
+            ::ContentionSampler::Record(timing, address, ::ContentionSampler::Operation::operation); \
+        }                                                                                          \
+    } while (false)
+
+#else
+
+#define SP_CONTENTION_BEGIN(timing, type_name) ((void)0)
+#define SP_CONTENTION_END(timing, address, operation) ((void)0)
+
+#endif //SMARTPOINTERS_CONTENTION_SAMPLING
+
+#endif //CONTENTIONSAMPLER_H
@@ -0,0 +1,103 @@
+#ifndef COWPTR_H
+#define COWPTR_H
+
+#include <assert.h>
+#include <utility>
+
+#include "IntrusivePtr.h"
+
+// Copy-on-write value. Copies share one immutable T; Write() hands out a
+// mutable reference, cloning T first if any other CowPtr still shares it.
+//
+// The uniqueness check is safe without a lock: once the count reads 1, the
+// only owner is the caller's own CowPtr, so no other thread can add a sharer
+// until the caller copies it again. The check is an acquire load, so writes
+// made through the previous owners happen-before the caller's.
+//
+// A reference returned by Write() is only valid until the CowPtr is copied.
+
+template <class T>
+class CowPtr
+{
+public:
+    template <class... Args>
+    explicit CowPtr(std::in_place_t, Args&&... args)
+        : holder_(new Holder(std::forward<Args>(args)...))
+    {
+    }
+
+    CowPtr() : CowPtr(std::in_place)
+    {
+    }
+
+    CowPtr(T value) : CowPtr(std::in_place, std::move(value))
+    {
+    }
+
+    const T& operator*() const
+    {
+        return holder_->value;
+    }
+
+    const T* operator->() const
+    {
+        return &holder_->value;
+    }
+
+    const T* get() const
+    {
+        return &holder_->value;
+    }
+
+    T& Write()
+    {
+        assert(holder_ && "Write() on a moved-from CowPtr");
+        if (!holder_.unique())
+        {
+            holder_ = IntrusivePtr<Holder>(new Holder(std::as_const(holder_->value)));
+        }
+        return holder_->value;
+    }
+
+    [[nodiscard]] unsigned int use_count() const
+    {
+        return holder_.use_count();
+    }
+
+    [[nodiscard]] bool unique() const
+    {
+        return holder_.unique();
+    }
+
+    // True if both share the same T, so comparing values can be skipped.
+    [[nodiscard]] bool SharesWith(const CowPtr& other) const
+    {
+        return holder_.get() == other.holder_.get();
+    }
+
+    void swap(CowPtr& other) noexcept
+    {
+        holder_.swap(other.holder_);
+    }
+
+private:
+    struct Holder : RefCounter
+    {
+        template <class... Args>
+        explicit Holder(Args&&... args) : value(std::forward<Args>(args)...)
+        {
+        }
+
+        T value;
+    };
+
+    IntrusivePtr<Holder> holder_;
+};
+
+template <class T, class... Args>
+CowPtr<T> MakeCow(Args&&... args)
+{
+    return CowPtr<T>(std::in_place, std::forward<Args>(args)...);
+}
+
+#endif //COWPTR_H
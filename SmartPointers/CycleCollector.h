@@ -0,0 +1,621 @@
+#ifndef CYCLECOLLECTOR_H
+#define CYCLECOLLECTOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "IntrusivePtr.h"
+
+// Cycle collector for IntrusivePtr graphs (trial deletion in the style of
+// Bacon and Rajan's synchronous cycle collection), run either in one call or
+// incrementally in bounded steps.
+//
+// Only IntrusivePtr edges between CycleCollectable objects are traced.
+// SharedPointer keeps its counts in a separate control block that the
+// collector cannot see, so cycles through SharedPointer are never collected.
+// Collection is not concurrent: it runs on the calling thread, and the graphs
+// it examines must be quiet until it finishes.
+//
+// Types opt in by deriving from CycleCollectable and reporting their
+// IntrusivePtr fields from Trace(). Whenever a release leaves such an object
+// with a non-zero count it is buffered as a candidate root. Collect() takes a
+// batch of candidates, subtracts the references that come from inside the
+// subgraph reachable from them, and frees every object whose references all
+// come from garbage. Counts are never modified during the trial: each object
+// carries a separate shadow count.
+//
+// Candidate buffering is thread-safe. Collect() may run on any thread, but the
+// subgraphs reachable from the candidates must not be mutated while it marks
+// them. Its budget limits how many candidates one call takes, not how much
+// work it does: one large connected graph is examined whole and the pause
+// grows with its size.
+//
+// Step(work) bounds the pause instead. The collection's state (roots, work
+// stacks, garbage found so far) lives in the collector, and each step visits
+// at most about work objects before returning, freeing garbage a slice at a
+// time as well. A program can thus spread a large collection over frames or
+// idle periods. Between the first step and the one that reports the
+// collection finished, the subgraphs reachable from its candidates must stay
+// as quiet as during Collect(); buffering new candidates elsewhere is fine.
+//
+// Collection can also be made to run by itself with SetAutoCollect(threshold):
+// once a release buffers a candidate while the buffer holds threshold of them,
+// that release first collects up to the budget's worth of the oldest
+// candidates. The next automatic collection then waits until at least as many
+// candidates are buffered as the last one found live objects, so a large live
+// graph released piecemeal is not marked again at every threshold. This is off
+// by default, because the collecting release may be on any thread; enable it
+// only when no other thread mutates collectable graphs, and otherwise call
+// Collect() at points where those graphs are quiet.
+
+class CycleTracer
+{
+public:
+    template <class T>
+    void operator()(IntrusivePtr<T>& edge);
+
+private:
+    struct DetachedEdge
+    {
+        CycleCollectable* target;
+        void (*drop)(CycleCollectable*);
+    };
+
+    template <class T>
+    static void DropEdge(CycleCollectable* target)
+    {
+        // Dies at the end of the scope, releasing the reference with T's hooks.
+        IntrusivePtr<T> owner(static_cast<T*>(target), typename IntrusivePtr<T>::AdoptTag{});
+    }
+
+    // Children are collected while marking; edges into garbage are detached
+    // while freeing.
+    bool detach_ = false;
+    std::vector<CycleCollectable*> children_;
+    std::vector<DetachedEdge> detached_;
+
+    friend class CycleCollector;
+};
+
+class CycleCollectable : public RefCounter
+{
+public:
+    CycleCollectable()
+    {
+        ref_count.fetch_or(kCollectableFlag, std::memory_order_relaxed);
+    }
+
+    inline ~CycleCollectable() override;
+
+    // Reports every IntrusivePtr field of the object to tracer.
+    virtual void Trace(CycleTracer& tracer) = 0;
+
+private:
+    enum class Color : std::uint8_t
+    {
+        Black,
+        Gray,
+        White,
+        Collecting
+    };
+
+    inline void OnPossibleCycleRoot() override;
+
+    [[nodiscard]] unsigned int Count() const
+    {
+        return ref_count.load(std::memory_order_relaxed) & kCountMask;
+    }
+
+    // Collector state, only touched by the collecting thread.
+    Color color_ = Color::Black;
+    unsigned int shadow_count_ = 0;
+
+    // Root buffer membership; the links are guarded by the collector's mutex.
+    std::atomic<bool> buffered_ = false;
+    bool listed_ = false;
+    CycleCollectable* prev_ = nullptr;
+    CycleCollectable* next_ = nullptr;
+
+    friend class CycleCollector;
+    friend class CycleTracer;
+};
+
+class CycleCollector
+{
+public:
+    static CycleCollector& Instance()
+    {
+        // Never destroyed: buffered objects may die during static destruction.
+        static CycleCollector* collector = new CycleCollector();
+        return *collector;
+    }
+
+    static constexpr std::size_t kDefaultAutoBudget = 4096;
+
+    [[nodiscard]] std::size_t Candidates()
+    {
+        std::lock_guard lock(mutex_);
+        return candidates_;
+    }
+
+    // Collects up to budget candidates whenever a release finds threshold of
+    // them buffered; a threshold of 0, the default, leaves collection to
+    // explicit calls.
+    void SetAutoCollect(std::size_t threshold, std::size_t budget = kDefaultAutoBudget)
+    {
+        std::lock_guard lock(mutex_);
+        auto_threshold_ = threshold;
+        auto_budget_ = budget;
+        next_auto_ = threshold;
+    }
+
+    // Examines up to budget candidate roots and frees the garbage cycles
+    // reachable from them, in one call. If an incremental collection is under
+    // way it is finished instead, with the budget it was started with. Returns
+    // the number of objects freed; 0 if called while a step is running, from
+    // a destructor the collection triggered or on another thread.
+    std::size_t Collect(std::size_t budget = std::numeric_limits<std::size_t>::max())
+    {
+        if (stepping_.exchange(true, std::memory_order_acquire))
+        {
+            return 0;
+        }
+        try
+        {
+            if (cycle_.phase == Phase::Idle)
+            {
+                Begin(budget);
+            }
+            while (cycle_.phase != Phase::Idle)
+            {
+                Advance(std::numeric_limits<std::size_t>::max());
+            }
+        }
+        catch (...)
+        {
+            stepping_.store(false, std::memory_order_release);
+            throw;
+        }
+        const std::size_t freed = cycle_.freed;
+        stepping_.store(false, std::memory_order_release);
+        return freed;
+    }
+
+    // Advances an incremental collection by about work object visits and
+    // returns whether it has finished. The collection takes up to budget
+    // candidates, oldest first, as its marking reaches them; budget is only
+    // read by the step that starts it. A collection ends with its garbage
+    // freed, which is also done a slice at a time. Between steps the graphs
+    // reachable from the taken candidates must not be mutated, as during
+    // Collect(). Returns false at once if another step is running.
+    bool Step(std::size_t work, std::size_t budget = std::numeric_limits<std::size_t>::max())
+    {
+        if (stepping_.exchange(true, std::memory_order_acquire))
+        {
+            return false;
+        }
+        try
+        {
+            if (cycle_.phase == Phase::Idle)
+            {
+                Begin(budget);
+            }
+            Advance(std::max<std::size_t>(work, 1));
+        }
+        catch (...)
+        {
+            stepping_.store(false, std::memory_order_release);
+            throw;
+        }
+        const bool finished = cycle_.phase == Phase::Idle;
+        stepping_.store(false, std::memory_order_release);
+        return finished;
+    }
+
+    // Objects the last finished collection freed; read it on the thread that
+    // finished it.
+    [[nodiscard]] std::size_t LastFreed() const
+    {
+        return cycle_.freed;
+    }
+
+private:
+    using Color = CycleCollectable::Color;
+
+    enum class Phase
+    {
+        Idle,
+        MarkGray,
+        Scan,
+        CollectWhite,
+        Detach,
+        Drop
+    };
+
+    // Everything a collection needs to resume where the last step stopped.
+    // Only touched by the thread holding stepping_.
+    struct Cycle
+    {
+        Phase phase = Phase::Idle;
+        // Candidates are taken as marking reaches them, up to budget.
+        std::size_t budget = 0;
+        std::vector<CycleCollectable*> roots;
+        std::size_t next_root = 0;
+        // Work stacks are reused by every root and phase to keep the traversal allocation-free.
+        std::vector<CycleCollectable*> stack;
+        std::vector<CycleCollectable*> black_stack;
+        std::vector<CycleCollectable*> garbage;
+        std::size_t marked = 0;
+        std::size_t next_garbage = 0;
+        std::size_t next_edge = 0;
+        std::size_t freed = 0;
+        CycleTracer tracer;
+    };
+
+    CycleCollector() = default;
+
+    void Begin(std::size_t budget)
+    {
+        Cycle& cycle = cycle_;
+        cycle.roots.clear();
+        cycle.stack.clear();
+        cycle.black_stack.clear();
+        cycle.garbage.clear();
+        cycle.tracer.detached_.clear();
+        cycle.tracer.detach_ = false;
+        cycle.next_root = 0;
+        cycle.marked = 0;
+        cycle.next_garbage = 0;
+        cycle.next_edge = 0;
+        cycle.budget = budget;
+        cycle.phase = Phase::MarkGray;
+    }
+
+    // Runs up to work units of the collection. Marking runs under mutex_;
+    // freeing runs without it, since dropping references re-enters the buffer.
+    void Advance(std::size_t work)
+    {
+        Cycle& cycle = cycle_;
+        while (work > 0 && cycle.phase != Phase::Idle)
+        {
+            if (cycle.phase == Phase::Detach || cycle.phase == Phase::Drop)
+            {
+                FreeSlice(work);
+                continue;
+            }
+            std::lock_guard lock(mutex_);
+            while (work > 0 && cycle.phase != Phase::Detach)
+            {
+                --work;
+                switch (cycle.phase)
+                {
+                case Phase::MarkGray:
+                    MarkGrayUnit();
+                    break;
+                case Phase::Scan:
+                    ScanUnit();
+                    break;
+                default:
+                    CollectWhiteUnit();
+                    break;
+                }
+            }
+        }
+    }
+
+    static void Children(CycleCollectable* object, CycleTracer& tracer, std::vector<CycleCollectable*>& stack)
+    {
+        tracer.children_.clear();
+        object->Trace(tracer);
+        stack.insert(stack.end(), tracer.children_.begin(), tracer.children_.end());
+    }
+
+    // Takes the next root once the stack is empty, or the phase's next
+    // object. Returns null when the phase has run out of roots. Requires mutex_.
+    CycleCollectable* NextUnit(std::vector<CycleCollectable*>& stack)
+    {
+        Cycle& cycle = cycle_;
+        if (stack.empty())
+        {
+            // Oldest first: recent candidates are the likeliest to still be in use.
+            if (cycle.phase == Phase::MarkGray && cycle.next_root == cycle.roots.size() && tail_ != nullptr &&
+                cycle.roots.size() < cycle.budget)
+            {
+                CycleCollectable* root = tail_;
+                Unlink(root);
+                cycle.roots.push_back(root);
+            }
+            if (cycle.next_root == cycle.roots.size())
+            {
+                cycle.next_root = 0;
+                return nullptr;
+            }
+            return cycle.roots[cycle.next_root++];
+        }
+        CycleCollectable* object = stack.back();
+        stack.pop_back();
+        return object;
+    }
+
+    // Shadow count of every object reachable from the roots, minus the
+    // references coming from within that subgraph.
+    void MarkGrayUnit()
+    {
+        Cycle& cycle = cycle_;
+        const bool from_root = cycle.stack.empty();
+        CycleCollectable* object = NextUnit(cycle.stack);
+        if (object == nullptr)
+        {
+            cycle.phase = Phase::Scan;
+            return;
+        }
+        if (from_root)
+        {
+            if (object->color_ == Color::Gray)
+            {
+                return;
+            }
+            object->color_ = Color::Gray;
+            object->shadow_count_ = object->Count();
+            ++cycle.marked;
+        }
+        cycle.tracer.children_.clear();
+        object->Trace(cycle.tracer);
+        for (CycleCollectable* child : cycle.tracer.children_)
+        {
+            if (child->color_ != Color::Gray)
+            {
+                child->color_ = Color::Gray;
+                child->shadow_count_ = child->Count();
+                cycle.stack.push_back(child);
+                ++cycle.marked;
+            }
+            --child->shadow_count_;
+        }
+    }
+
+    // Objects with external references stay alive along with everything they
+    // reach; the rest are garbage. Blackening a live object's subgraph
+    // finishes before the scan goes on.
+    void ScanUnit()
+    {
+        Cycle& cycle = cycle_;
+        if (!cycle.black_stack.empty())
+        {
+            CycleCollectable* object = cycle.black_stack.back();
+            cycle.black_stack.pop_back();
+            if (object->color_ != Color::Black)
+            {
+                object->color_ = Color::Black;
+                Children(object, cycle.tracer, cycle.black_stack);
+            }
+            return;
+        }
+        CycleCollectable* object = NextUnit(cycle.stack);
+        if (object == nullptr)
+        {
+            cycle.phase = Phase::CollectWhite;
+            return;
+        }
+        if (object->color_ != Color::Gray)
+        {
+            return;
+        }
+        if (object->shadow_count_ > 0)
+        {
+            object->color_ = Color::Black;
+            Children(object, cycle.tracer, cycle.black_stack);
+            return;
+        }
+        object->color_ = Color::White;
+        Children(object, cycle.tracer, cycle.stack);
+    }
+
+    void CollectWhiteUnit()
+    {
+        Cycle& cycle = cycle_;
+        CycleCollectable* object = NextUnit(cycle.stack);
+        if (object == nullptr)
+        {
+            last_live_ = cycle.marked - cycle.garbage.size();
+            cycle.tracer.detach_ = true;
+            cycle.phase = Phase::Detach;
+            return;
+        }
+        if (object->color_ != Color::White)
+        {
+            return;
+        }
+        object->color_ = Color::Collecting;
+        if (object->listed_)
+        {
+            Unlink(object);
+        }
+        cycle.garbage.push_back(object);
+        Children(object, cycle.tracer, cycle.stack);
+    }
+
+    // Garbage is only referenced by other garbage. Detaching those edges
+    // leaves each object owned by the detached references alone; dropping
+    // them then destroys the objects through the ordinary release path.
+    void FreeSlice(std::size_t& work)
+    {
+        Cycle& cycle = cycle_;
+        while (work > 0 && cycle.phase == Phase::Detach)
+        {
+            if (cycle.next_garbage == cycle.garbage.size())
+            {
+                cycle.phase = Phase::Drop;
+                break;
+            }
+            --work;
+            cycle.garbage[cycle.next_garbage++]->Trace(cycle.tracer);
+        }
+        while (work > 0 && cycle.phase == Phase::Drop)
+        {
+            if (cycle.next_edge == cycle.tracer.detached_.size())
+            {
+                cycle.freed = cycle.garbage.size();
+                cycle.garbage.clear();
+                cycle.tracer.detached_.clear();
+                cycle.phase = Phase::Idle;
+                break;
+            }
+            --work;
+            const CycleTracer::DetachedEdge edge = cycle.tracer.detached_[cycle.next_edge++];
+            edge.drop(edge.target);
+        }
+    }
+
+    void Buffer(CycleCollectable* object)
+    {
+        std::lock_guard lock(mutex_);
+        object->listed_ = true;
+        object->prev_ = nullptr;
+        object->next_ = head_;
+        if (head_ != nullptr)
+        {
+            head_->prev_ = object;
+        }
+        else
+        {
+            tail_ = object;
+        }
+        head_ = object;
+        ++candidates_;
+    }
+
+    // Runs an automatic collection if the buffer has reached the threshold.
+    // Releases made while it runs, on any thread, do not start another.
+    void MaybeCollect()
+    {
+        std::size_t budget = 0;
+        {
+            std::lock_guard lock(mutex_);
+            if (auto_threshold_ == 0 || auto_running_ || candidates_ < next_auto_)
+            {
+                return;
+            }
+            auto_running_ = true;
+            budget = auto_budget_;
+        }
+        try
+        {
+            Collect(budget);
+        }
+        catch (...)
+        {
+            std::lock_guard lock(mutex_);
+            auto_running_ = false;
+            throw;
+        }
+        std::lock_guard lock(mutex_);
+        auto_running_ = false;
+        next_auto_ = std::max(auto_threshold_, last_live_);
+    }
+
+    void Forget(CycleCollectable* object)
+    {
+        std::lock_guard lock(mutex_);
+        if (object->listed_)
+        {
+            Unlink(object);
+        }
+    }
+
+    // Requires mutex_.
+    void Unlink(CycleCollectable* object)
+    {
+        if (object->prev_ != nullptr)
+        {
+            object->prev_->next_ = object->next_;
+        }
+        else
+        {
+            head_ = object->next_;
+        }
+        if (object->next_ != nullptr)
+        {
+            object->next_->prev_ = object->prev_;
+        }
+        else
+        {
+            tail_ = object->prev_;
+        }
+        object->prev_ = nullptr;
+        object->next_ = nullptr;
+        object->listed_ = false;
+        object->buffered_.store(false, std::memory_order_relaxed);
+        --candidates_;
+    }
+
+    std::mutex mutex_;
+    // Newest candidate at the head, oldest at the tail.
+    CycleCollectable* head_ = nullptr;
+    CycleCollectable* tail_ = nullptr;
+    std::size_t candidates_ = 0;
+    std::size_t auto_threshold_ = 0;
+    std::size_t auto_budget_ = kDefaultAutoBudget;
+    std::size_t next_auto_ = 0;
+    bool auto_running_ = false;
+    // Live objects the last collection marked.
+    std::size_t last_live_ = 0;
+
+    // Held by the thread running Collect() or Step().
+    std::atomic<bool> stepping_ = false;
+    Cycle cycle_;
+
+    friend class CycleCollectable;
+};
+
+inline CycleCollectable::~CycleCollectable()
+{
+    if (buffered_.load(std::memory_order_relaxed))
+    {
+        CycleCollector::Instance().Forget(this);
+    }
+}
+
+inline void CycleCollectable::OnPossibleCycleRoot()
+{
+    if (color_ == Color::Collecting || buffered_.exchange(true, std::memory_order_relaxed))
+    {
+        return;
+    }
+    // Collect before this object joins the buffer: the reference its caller
+    // is about to drop would make it look live, and taking it now would lose
+    // it as a candidate.
+    CycleCollector& collector = CycleCollector::Instance();
+    collector.MaybeCollect();
+    collector.Buffer(this);
+}
+
+template <class T>
+void CycleTracer::operator()(IntrusivePtr<T>& edge)
+{
+    if constexpr (std::is_base_of_v<CycleCollectable, T>)
+    {
+        CycleCollectable* target = edge.ref_;
+        if (target == nullptr)
+        {
+            return;
+        }
+        if (!detach_)
+        {
+            children_.push_back(target);
+        }
+        else if (target->color_ == CycleCollectable::Color::Collecting)
+        {
+            detached_.push_back({target, &DropEdge<T>});
+            edge.ref_ = nullptr;
+        }
+    }
+}
+
+#endif //CYCLECOLLECTOR_H
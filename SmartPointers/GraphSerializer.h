@@ -0,0 +1,506 @@
+#ifndef GRAPHSERIALIZER_H
+#define GRAPHSERIALIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SMARTPOINTERS_GRAPH_MMAP 1
+#endif
+
+#include "IntrusivePtr.h"
+
+// Binary snapshots of IntrusivePtr graphs that keep object identity. The
+// writer numbers objects as it first reaches them and writes each one once;
+// an edge is stored as the index of its target, so shared objects and cycles
+// survive the round trip.
+//
+// A type takes part by providing
+//     void Serialize(GraphWriter& out) const;   // out.Value(...), out.Reference(...)
+//     void Deserialize(GraphReader& in);        // the same fields, same order
+// and a default constructor. Edges are read with their static type, so a
+// field must not hold a derived type. Value() copies plain fields byte for
+// byte, so their types must not hold addresses: raw pointers are rejected at
+// compile time, but a struct that contains one would be written as it is and
+// read back dangling. Edges go through Reference(). Each record starts with a
+// tag of the type it was written as, and loading it as any other type throws.
+//
+// The reader maps the file and builds objects only when they are asked for:
+// Load<T>(index) materializes that object and whatever it reaches, and leaves
+// the rest of the file untouched. Opening a snapshot costs the same at any
+// size. Loading is two-phase (allocate and register, then read fields), so
+// cycles and long chains need neither recursion nor fix-ups. Counts come out
+// as the number of edges plus the caller's pointers, plus one reference the
+// reader keeps per object so that later loads return the same objects. A load
+// that throws drops the objects it had started, so a later load builds them
+// again instead of returning half-read ones.
+
+class GraphReader;
+
+class GraphWriter
+{
+public:
+    static constexpr std::uint32_t kNullIndex = 0xffffffffu;
+
+    // Writes root and everything it reaches; returns root's index (always 0
+    // for the first call). Several roots may be written to one snapshot. The
+    // writer keeps every object it has numbered alive until it is destroyed,
+    // so an address it has seen cannot be reused by a later object.
+    template <class T>
+    std::uint32_t Write(const IntrusivePtr<T>& root)
+    {
+        const std::uint32_t index = Enqueue(root);
+        while (next_ < pending_.size())
+        {
+            // Serializing may queue more objects and move pending_.
+            const Pending& object = pending_[next_++];
+            const RefCounter* target = object.object.get();
+            const auto serialize = object.serialize;
+            offsets_.push_back(data_.size());
+            Value(object.type);
+            serialize(*this, target);
+        }
+        return index;
+    }
+
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    void Value(const T& value)
+    {
+        static_assert(!std::is_pointer_v<T> && !std::is_member_pointer_v<T>,
+                      "Addresses are meaningless once read back; write edges with Reference()");
+        const auto* bytes = reinterpret_cast<const std::byte*>(&value);
+        data_.insert(data_.end(), bytes, bytes + sizeof(T));
+    }
+
+    void Value(const std::string& value)
+    {
+        Value(static_cast<std::uint64_t>(value.size()));
+        const auto* bytes = reinterpret_cast<const std::byte*>(value.data());
+        data_.insert(data_.end(), bytes, bytes + value.size());
+    }
+
+    // Writes the index of target, queueing it if it has not been seen yet.
+    template <class T>
+    std::uint32_t Reference(const IntrusivePtr<T>& target)
+    {
+        const std::uint32_t index = Enqueue(target);
+        Value(index);
+        return index;
+    }
+
+    [[nodiscard]] std::size_t ObjectCount() const
+    {
+        return pending_.size();
+    }
+
+    // The snapshot: header, record offsets, then the records.
+    [[nodiscard]] std::vector<std::byte> Finish() const
+    {
+        const std::uint32_t count = static_cast<std::uint32_t>(offsets_.size());
+        const std::uint64_t table_bytes = (std::uint64_t{count} + 1) * sizeof(std::uint64_t);
+        Header header{kMagic, kVersion, count, sizeof(Header) + table_bytes};
+
+        std::vector<std::byte> out(sizeof(Header) + table_bytes + data_.size());
+        std::memcpy(out.data(), &header, sizeof(Header));
+        std::byte* table = out.data() + sizeof(Header);
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            std::memcpy(table + i * sizeof(std::uint64_t), &offsets_[i], sizeof(std::uint64_t));
+        }
+        const std::uint64_t end = data_.size();
+        std::memcpy(table + count * sizeof(std::uint64_t), &end, sizeof(std::uint64_t));
+        if (!data_.empty())
+        {
+            std::memcpy(out.data() + header.data_offset, data_.data(), data_.size());
+        }
+        return out;
+    }
+
+    void Save(const std::string& path) const
+    {
+        const std::vector<std::byte> bytes = Finish();
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        if (!file)
+        {
+            throw std::runtime_error("GraphWriter: cannot write " + path);
+        }
+    }
+
+private:
+    static constexpr std::uint64_t kMagic = 0x48504152475053;
+    static constexpr std::uint32_t kVersion = 2;
+
+    struct Header
+    {
+        std::uint64_t magic;
+        std::uint32_t version;
+        std::uint32_t count;
+        std::uint64_t data_offset;
+    };
+
+    struct Pending
+    {
+        IntrusivePtr<RefCounter> object;
+        std::uint64_t type;
+        void (*serialize)(GraphWriter&, const RefCounter*);
+    };
+
+    // FNV-1a of the type's name: stable across runs of the same build, unlike
+    // type_info::hash_code.
+    template <class T>
+    static std::uint64_t TypeTag()
+    {
+        static const std::uint64_t tag = []
+        {
+            std::uint64_t hash = 0xcbf29ce484222325;
+            for (const char* c = typeid(T).name(); *c != '\0'; ++c)
+            {
+                hash = (hash ^ static_cast<unsigned char>(*c)) * 0x100000001b3;
+            }
+            return hash;
+        }();
+        return tag;
+    }
+
+    // Numbers target and queues it if it has not been seen yet; writes nothing.
+    template <class T>
+    std::uint32_t Enqueue(const IntrusivePtr<T>& target)
+    {
+        if (!target)
+        {
+            return kNullIndex;
+        }
+        auto [it, inserted] = ids_.try_emplace(target.get(), static_cast<std::uint32_t>(pending_.size()));
+        if (inserted)
+        {
+            pending_.push_back({IntrusivePtr<RefCounter>(target.get()), TypeTag<T>(), &SerializeThunk<T>});
+        }
+        return it->second;
+    }
+
+    template <class T>
+    static void SerializeThunk(GraphWriter& out, const RefCounter* object)
+    {
+        static_cast<const T*>(object)->Serialize(out);
+    }
+
+    std::unordered_map<const RefCounter*, std::uint32_t> ids_;
+    std::vector<Pending> pending_;
+    std::size_t next_ = 0;
+    std::vector<std::uint64_t> offsets_;
+    std::vector<std::byte> data_;
+
+    friend class GraphReader;
+};
+
+
+class GraphReader
+{
+public:
+    // Reads a snapshot held in memory; bytes must outlive the reader.
+    explicit GraphReader(std::span<const std::byte> bytes) : bytes_(bytes)
+    {
+        Validate();
+    }
+
+#ifdef SMARTPOINTERS_GRAPH_MMAP
+    // Maps the file read-only; pages are read as records are first touched.
+    static GraphReader Open(const std::string& path)
+    {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0)
+        {
+            const int error = errno;
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            throw std::system_error(error, std::generic_category(), "GraphReader: " + path);
+        }
+        const auto size = static_cast<std::size_t>(info.st_size);
+        void* mapping = size == 0 ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            throw std::runtime_error("GraphReader: cannot map " + path);
+        }
+        return GraphReader(mapping, size);
+    }
+#endif
+
+    GraphReader(GraphReader&& other) noexcept
+        : bytes_(other.bytes_), mapping_(std::exchange(other.mapping_, nullptr)), count_(other.count_),
+          data_(other.data_), objects_(std::move(other.objects_))
+    {
+    }
+
+    GraphReader(const GraphReader&) = delete;
+    GraphReader& operator=(const GraphReader&) = delete;
+    GraphReader& operator=(GraphReader&&) = delete;
+
+    ~GraphReader()
+    {
+#ifdef SMARTPOINTERS_GRAPH_MMAP
+        if (mapping_ != nullptr)
+        {
+            munmap(mapping_, bytes_.size());
+        }
+#endif
+    }
+
+    [[nodiscard]] std::uint32_t ObjectCount() const
+    {
+        return count_;
+    }
+
+    // Object index and everything it reaches, built on first request.
+    template <class T>
+    IntrusivePtr<T> Load(std::uint32_t index)
+    {
+        try
+        {
+            IntrusivePtr<T> result = Materialize<T>(index);
+            while (!pending_.empty())
+            {
+                const Pending object = pending_.back();
+                pending_.pop_back();
+                cursor_ = Record(object.index).subspan(sizeof(std::uint64_t));
+                object.deserialize(*this, object.object);
+            }
+            started_.clear();
+            return result;
+        }
+        catch (...)
+        {
+            // Objects built by this load may be half read; earlier loads never
+            // reach them, so dropping them leaves the reader consistent.
+            pending_.clear();
+            for (const std::uint32_t started : started_)
+            {
+                objects_[started] = Built();
+            }
+            started_.clear();
+            throw;
+        }
+    }
+
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    void Value(T& value)
+    {
+        static_assert(!std::is_pointer_v<T> && !std::is_member_pointer_v<T>,
+                      "Addresses are meaningless once read back; read edges with Reference()");
+        std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+    }
+
+    void Value(std::string& value)
+    {
+        std::uint64_t size = 0;
+        Value(size);
+        const std::byte* bytes = Take(size);
+        value.assign(reinterpret_cast<const char*>(bytes), size);
+    }
+
+    template <class T>
+    void Reference(IntrusivePtr<T>& target)
+    {
+        std::uint32_t index = 0;
+        Value(index);
+        target = index == GraphWriter::kNullIndex ? IntrusivePtr<T>() : Materialize<T>(index);
+    }
+
+    // Drops the reader's own references; later loads build new objects.
+    void Forget()
+    {
+        objects_.clear();
+    }
+
+private:
+    struct Pending
+    {
+        std::uint32_t index;
+        RefCounter* object;
+        void (*deserialize)(GraphReader&, RefCounter*);
+    };
+
+    // Holds one reference per built object; the static type is only needed
+    // for the matching release.
+    struct Built
+    {
+        RefCounter* object = nullptr;
+        void (*release)(RefCounter*) = nullptr;
+
+        Built() = default;
+
+        Built(RefCounter* object, void (*release)(RefCounter*)) : object(object), release(release)
+        {
+        }
+
+        Built(Built&& other) noexcept
+            : object(std::exchange(other.object, nullptr)), release(other.release)
+        {
+        }
+
+        Built& operator=(Built&& other) noexcept
+        {
+            std::swap(object, other.object);
+            std::swap(release, other.release);
+            return *this;
+        }
+
+        ~Built()
+        {
+            if (object)
+            {
+                release(object);
+            }
+        }
+    };
+
+#ifdef SMARTPOINTERS_GRAPH_MMAP
+    GraphReader(void* mapping, std::size_t size)
+        : bytes_(static_cast<const std::byte*>(mapping), size), mapping_(mapping)
+    {
+        try
+        {
+            Validate();
+        }
+        catch (...)
+        {
+            munmap(mapping_, size);
+            mapping_ = nullptr;
+            throw;
+        }
+    }
+#endif
+
+    void Validate()
+    {
+        GraphWriter::Header header;
+        if (bytes_.size() < sizeof(header))
+        {
+            throw std::runtime_error("GraphReader: truncated header");
+        }
+        std::memcpy(&header, bytes_.data(), sizeof(header));
+        if (header.magic != GraphWriter::kMagic || header.version != GraphWriter::kVersion)
+        {
+            throw std::runtime_error("GraphReader: not a graph snapshot");
+        }
+        const std::uint64_t table_bytes = (std::uint64_t{header.count} + 1) * sizeof(std::uint64_t);
+        if (header.data_offset != sizeof(header) + table_bytes || header.data_offset > bytes_.size()
+            || Offset(header.count) > bytes_.size() - header.data_offset)
+        {
+            throw std::runtime_error("GraphReader: corrupt object table");
+        }
+        count_ = header.count;
+        data_ = bytes_.subspan(header.data_offset);
+    }
+
+    std::uint64_t Offset(std::uint32_t index) const
+    {
+        std::uint64_t offset = 0;
+        std::memcpy(&offset, bytes_.data() + sizeof(GraphWriter::Header) + index * sizeof(std::uint64_t),
+                    sizeof(offset));
+        return offset;
+    }
+
+    std::span<const std::byte> Record(std::uint32_t index) const
+    {
+        const std::uint64_t begin = Offset(index);
+        const std::uint64_t end = Offset(index + 1);
+        if (begin > end || end > data_.size())
+        {
+            throw std::runtime_error("GraphReader: corrupt record offsets");
+        }
+        if (end - begin < sizeof(std::uint64_t))
+        {
+            throw std::runtime_error("GraphReader: record without a type tag");
+        }
+        return data_.subspan(begin, end - begin);
+    }
+
+    const std::byte* Take(std::size_t size)
+    {
+        if (size > cursor_.size())
+        {
+            throw std::runtime_error("GraphReader: record overrun");
+        }
+        const std::byte* bytes = cursor_.data();
+        cursor_ = cursor_.subspan(size);
+        return bytes;
+    }
+
+    template <class T>
+    IntrusivePtr<T> Materialize(std::uint32_t index)
+    {
+        if (index >= count_)
+        {
+            throw std::runtime_error("GraphReader: object index out of range");
+        }
+        if (objects_.empty())
+        {
+            // Sized on first use so that opening a snapshot touches no per-object state.
+            objects_.resize(count_);
+        }
+        std::uint64_t type = 0;
+        std::memcpy(&type, Record(index).data(), sizeof(type));
+        if (type != GraphWriter::TypeTag<T>())
+        {
+            throw std::runtime_error("GraphReader: object " + std::to_string(index) + " was written as another type");
+        }
+        Built& built = objects_[index];
+        if (built.object == nullptr)
+        {
+            IntrusivePtr<T> object = make_intrusive<T>();
+            // The reader's own reference, dropped by ~Built.
+            IntrusivePtr<T> kept = object;
+            built = Built(std::exchange(kept.ref_, nullptr), &ReleaseThunk<T>);
+            pending_.push_back({index, object.get(), &DeserializeThunk<T>});
+            started_.push_back(index);
+            return object;
+        }
+        return IntrusivePtr<T>(static_cast<T*>(built.object));
+    }
+
+    template <class T>
+    static void DeserializeThunk(GraphReader& in, RefCounter* object)
+    {
+        static_cast<T*>(object)->Deserialize(in);
+    }
+
+    template <class T>
+    static void ReleaseThunk(RefCounter* object)
+    {
+        IntrusivePtr<T> owner(static_cast<T*>(object), typename IntrusivePtr<T>::AdoptTag{});
+    }
+
+    std::span<const std::byte> bytes_;
+    void* mapping_ = nullptr;
+    std::uint32_t count_ = 0;
+    std::span<const std::byte> data_;
+    std::span<const std::byte> cursor_;
+    std::vector<Built> objects_;
+    std::vector<Pending> pending_;
+    // Objects built by the load in progress.
+    std::vector<std::uint32_t> started_;
+};
+
+#endif //GRAPHSERIALIZER_H
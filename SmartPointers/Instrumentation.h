@@ -0,0 +1,282 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <ostream>
+
+// Hot-path instrumentation for RefCounter/IntrusivePtr and SharedPointer.
+//
+// Enabled by defining SMARTPOINTERS_INSTRUMENTATION (the CMake option of the
+// same name does it for the SmartPointers target). When it is not defined the
+// SP_INSTRUMENT* macros expand to nothing and no counter state exists at all.
+//
+// Counters are kept per pointee type in thread-local blocks: a hot-path update
+// is a relaxed load/store on memory owned by the calling thread. Snapshot() and
+// DumpJson() aggregate every live thread plus the totals of exited threads.
+//
+// Creations and destructions of RefCounter objects are attributed to the
+// dynamic type, so live and peak counts stay right when an object is created
+// and released through pointers to different classes of its hierarchy.
+
+#ifdef SMARTPOINTERS_INSTRUMENTATION
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Instrumentation
+{
+    enum class Event : std::size_t
+    {
+        AddRef,
+        Release,
+        Created,
+        Destroyed,
+        MapLookup,
+        MapRehash,
+        MapCollision,
+        WeakLockHit,
+        WeakLockMiss,
+        Count
+    };
+
+    inline constexpr std::size_t kEventCount = static_cast<std::size_t>(Event::Count);
+    // Types registered past this limit share the last slot.
+    inline constexpr std::size_t kMaxTypes = 256;
+
+    inline constexpr const char* kEventNames[kEventCount] = {
+        "add_ref", "release", "created", "destroyed",
+        "map_lookups", "map_rehashes", "map_collisions",
+        "weak_lock_hits", "weak_lock_misses"
+    };
+
+    struct TypeStats
+    {
+        std::string name;
+        std::array<std::uint64_t, kEventCount> events{};
+        std::int64_t live = 0;
+        std::int64_t peak_live = 0;
+
+        [[nodiscard]] std::uint64_t operator[](Event event) const
+        {
+            return events[static_cast<std::size_t>(event)];
+        }
+    };
+
+    using CounterBlock = std::array<std::array<std::atomic<std::uint64_t>, kEventCount>, kMaxTypes>;
+
+    class Registry
+    {
+    public:
+        static Registry& Instance()
+        {
+            static Registry registry;
+            return registry;
+        }
+
+        std::size_t RegisterType(const std::type_info& type)
+        {
+            // Direct-mapped per-thread cache in front of the locked map. It has
+            // no destructor, so hooks that run from other thread_local
+            // destructors at thread exit can still use it.
+            struct CachedType
+            {
+                const std::type_info* type = nullptr;
+                std::size_t slot = 0;
+            };
+            static thread_local std::array<CachedType, 16> cache{};
+            CachedType& cached = cache[std::hash<const void*>{}(&type) % cache.size()];
+            if (cached.type == &type)
+            {
+                return cached.slot;
+            }
+            std::lock_guard lock(mutex_);
+            auto [slot, inserted] = slots_.try_emplace(std::type_index(type), kMaxTypes - 1);
+            if (inserted && type_count_ < kMaxTypes)
+            {
+                names_[type_count_] = type.name();
+                slot->second = type_count_++;
+            }
+            cached = {&type, slot->second};
+            return slot->second;
+        }
+
+        void Attach(CounterBlock* block)
+        {
+            std::lock_guard lock(mutex_);
+            threads_.insert(block);
+        }
+
+        void Detach(CounterBlock* block)
+        {
+            std::lock_guard lock(mutex_);
+            for (std::size_t type = 0; type < kMaxTypes; ++type)
+            {
+                for (std::size_t event = 0; event < kEventCount; ++event)
+                {
+                    retired_[type][event] += (*block)[type][event].load(std::memory_order_relaxed);
+                }
+            }
+            threads_.erase(block);
+        }
+
+        void OnLiveChange(std::size_t type, std::int64_t delta)
+        {
+            const std::int64_t live = live_[type].fetch_add(delta, std::memory_order_relaxed) + delta;
+            std::int64_t peak = peak_[type].load(std::memory_order_relaxed);
+            while (live > peak && !peak_[type].compare_exchange_weak(peak, live, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        [[nodiscard]] std::vector<TypeStats> Snapshot()
+        {
+            std::lock_guard lock(mutex_);
+            std::vector<TypeStats> stats(type_count_);
+            for (std::size_t type = 0; type < type_count_; ++type)
+            {
+                stats[type].name = names_[type];
+                stats[type].live = live_[type].load(std::memory_order_relaxed);
+                stats[type].peak_live = peak_[type].load(std::memory_order_relaxed);
+                for (std::size_t event = 0; event < kEventCount; ++event)
+                {
+                    std::uint64_t total = retired_[type][event];
+                    for (CounterBlock* block : threads_)
+                    {
+                        total += (*block)[type][event].load(std::memory_order_relaxed);
+                    }
+                    stats[type].events[event] = total;
+                }
+            }
+            return stats;
+        }
+
+    private:
+        Registry() = default;
+
+        std::mutex mutex_;
+        std::size_t type_count_ = 0;
+        std::array<const char*, kMaxTypes> names_{};
+        std::unordered_map<std::type_index, std::size_t> slots_;
+        std::array<std::array<std::uint64_t, kEventCount>, kMaxTypes> retired_{};
+        std::array<std::atomic<std::int64_t>, kMaxTypes> live_{};
+        std::array<std::atomic<std::int64_t>, kMaxTypes> peak_{};
+        std::unordered_set<CounterBlock*> threads_;
+    };
+
+    class ThreadCounters
+    {
+    public:
+        ThreadCounters()
+        {
+            Registry::Instance().Attach(&block_);
+        }
+
+        ~ThreadCounters()
+        {
+            Registry::Instance().Detach(&block_);
+        }
+
+        void Increment(std::size_t type, Event event)
+        {
+            auto& counter = block_[type][static_cast<std::size_t>(event)];
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+    private:
+        CounterBlock block_{};
+    };
+
+    inline ThreadCounters& LocalCounters()
+    {
+        static thread_local ThreadCounters counters;
+        return counters;
+    }
+
+    template <class Type>
+    std::size_t TypeSlot()
+    {
+        static const std::size_t slot = Registry::Instance().RegisterType(typeid(Type));
+        return slot;
+    }
+
+    inline void Record(std::size_t type, Event event)
+    {
+        LocalCounters().Increment(type, event);
+        if (event == Event::Created)
+        {
+            Registry::Instance().OnLiveChange(type, 1);
+        }
+        else if (event == Event::Destroyed)
+        {
+            Registry::Instance().OnLiveChange(type, -1);
+        }
+    }
+
+    template <class Type>
+    void Record(Event event)
+    {
+        Record(TypeSlot<Type>(), event);
+    }
+
+    // Attributes the event to the dynamic type of a live polymorphic object.
+    template <class Type>
+    void RecordObject(const Type* object, Event event)
+    {
+        Record(Registry::Instance().RegisterType(typeid(*object)), event);
+    }
+
+    inline std::vector<TypeStats> Snapshot()
+    {
+        return Registry::Instance().Snapshot();
+    }
+
+    inline void DumpJson(std::ostream& out)
+    {
+        out << "{\"enabled\":true,\"types\":[";
+        bool first = true;
+        for (const TypeStats& stats : Snapshot())
+        {
+            out << (first ? "" : ",") << "{\"name\":\"" << stats.name << '"';
+            for (std::size_t event = 0; event < kEventCount; ++event)
+            {
+                out << ",\"" << kEventNames[event] << "\":" << stats.events[event];
+            }
+            out << ",\"live\":" << stats.live << ",\"peak_live\":" << stats.peak_live << '}';
+            first = false;
+        }
+        out << "]}";
+    }
+}
+
+#define SP_INSTRUMENT(Type, event) ::Instrumentation::Record<Type>(::Instrumentation::Event::event)
+#define SP_INSTRUMENT_OBJECT(object, event) \
+    ::Instrumentation::RecordObject(object, ::Instrumentation::Event::event)
+#define SP_INSTRUMENT_IF(condition, Type, event) \
+    do { if (condition) { SP_INSTRUMENT(Type, event); } } while (false)
+
+#else
+
+namespace Instrumentation
+{
+    inline void DumpJson(std::ostream& out)
+    {
+        out << "{\"enabled\":false,\"types\":[]}";
+    }
+}
+
+#define SP_INSTRUMENT(Type, event) ((void)0)
+#define SP_INSTRUMENT_OBJECT(object, event) ((void)0)
+#define SP_INSTRUMENT_IF(condition, Type, event) ((void)0)
+
+#endif //SMARTPOINTERS_INSTRUMENTATION
+
+#endif //INSTRUMENTATION_H
@@ -0,0 +1,184 @@
+#ifndef INTERNTABLE_H
+#define INTERNTABLE_H
+
+#include <assert.h>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+#include <utility>
+
+#include "IntrusivePtr.h"
+
+// Hash-consing for immutable RefCounter objects. Intern() returns the live
+// object equal to its argument if there is one and creates it otherwise, so
+// memory grows with the number of distinct values rather than the number of
+// requests.
+//
+// The table holds its entries weakly: they do not keep objects alive. An
+// interned object is allocated as an Entry, whose Destroy() removes it from
+// the table when the last IntrusivePtr goes away. A lookup that races with
+// that final release sees a count of zero, fails to revive the object, and
+// replaces the dying entry with a fresh one; Destroy() then only erases the
+// entry if it is still its own.
+//
+// Interned objects are shared by every caller that asked for an equal value
+// and must not be modified. A table must outlive the objects interned in it.
+
+template <class T, class Hash = std::hash<T>, class KeyEqual = std::equal_to<T>>
+class InternTable
+{
+public:
+    InternTable() = default;
+    InternTable(const InternTable&) = delete;
+    InternTable& operator=(const InternTable&) = delete;
+
+    ~InternTable()
+    {
+        assert(size() == 0 && "InternTable destroyed while interned objects are alive");
+    }
+
+    static InternTable& Instance()
+    {
+        // Never destroyed: interned objects may die during static destruction.
+        static InternTable* table = new InternTable();
+        return *table;
+    }
+
+    IntrusivePtr<T> Intern(const T& value)
+    {
+        return Insert(value);
+    }
+
+    IntrusivePtr<T> Intern(T&& value)
+    {
+        return Insert(std::move(value));
+    }
+
+    // Number of entries, including ones whose final release is in progress.
+    [[nodiscard]] std::size_t size() const
+    {
+        std::size_t total = 0;
+        for (const Shard& shard : shards_)
+        {
+            std::lock_guard guard(shard.mutex);
+            total += shard.entries.size();
+        }
+        return total;
+    }
+
+private:
+    static constexpr std::size_t kShards = 64;
+
+    class Entry final : public T
+    {
+    public:
+        template <class Value>
+        Entry(InternTable& table, std::size_t hash, Value&& value)
+            : T(std::forward<Value>(value)), table(table), hash(hash)
+        {
+        }
+
+        InternTable& table;
+        const std::size_t hash;
+
+    private:
+        void Destroy() override
+        {
+            table.Erase(this);
+            delete this;
+        }
+    };
+
+    struct Lookup
+    {
+        const T& value;
+        std::size_t hash;
+    };
+
+    struct EntryHash
+    {
+        using is_transparent = void;
+
+        std::size_t operator()(const Entry* entry) const
+        {
+            return entry->hash;
+        }
+
+        std::size_t operator()(const Lookup& key) const
+        {
+            return key.hash;
+        }
+    };
+
+    struct EntryEqual
+    {
+        using is_transparent = void;
+
+        bool operator()(const Entry* left, const Entry* right) const
+        {
+            return left->hash == right->hash && KeyEqual{}(*left, *right);
+        }
+
+        bool operator()(const Lookup& key, const Entry* entry) const
+        {
+            return key.hash == entry->hash && KeyEqual{}(key.value, *entry);
+        }
+
+        bool operator()(const Entry* entry, const Lookup& key) const
+        {
+            return key.hash == entry->hash && KeyEqual{}(*entry, key.value);
+        }
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_set<Entry*, EntryHash, EntryEqual> entries;
+    };
+
+    Shard& ShardFor(std::size_t hash)
+    {
+        return shards_[hash % kShards];
+    }
+
+    template <class Value>
+    IntrusivePtr<T> Insert(Value&& value)
+    {
+        const std::size_t hash = Hash{}(value);
+        Shard& shard = ShardFor(hash);
+        std::lock_guard guard(shard.mutex);
+        auto it = shard.entries.find(Lookup{value, hash});
+        if (it != shard.entries.end())
+        {
+            Entry* entry = *it;
+            if (static_cast<RefCounter*>(entry)->TryAddRef())
+            {
+                SP_INSTRUMENT(T, AddRef);
+                return IntrusivePtr<T>(entry, typename IntrusivePtr<T>::AdoptTag{});
+            }
+            // Dying: its Destroy() is waiting for this lock and will find the
+            // slot taken by the replacement.
+            shard.entries.erase(it);
+        }
+        auto* entry = new Entry(*this, hash, std::forward<Value>(value));
+        shard.entries.insert(entry);
+        return IntrusivePtr<T>(entry);
+    }
+
+    void Erase(Entry* entry)
+    {
+        Shard& shard = ShardFor(entry->hash);
+        std::lock_guard guard(shard.mutex);
+        auto it = shard.entries.find(entry);
+        if (it != shard.entries.end() && *it == entry)
+        {
+            shard.entries.erase(it);
+        }
+    }
+
+    std::array<Shard, kShards> shards_;
+};
+
+#endif //INTERNTABLE_H
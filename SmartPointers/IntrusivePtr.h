@@ -2,54 +2,314 @@
 #define INTRUSIVEPTR_H
 
 #include <assert.h>
+#include <array>
 #include <atomic>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <type_traits>
 
+#include "Census.h"
+#include "ContentionSampler.h"
+#include "Instrumentation.h"
+#include "UniquePointer.h"
+
 
 
 
 class RefCounter;
+struct WeakControl;
+class WeakSideTable;
+class CycleCollectable;
+class CycleCollector;
+class CycleTracer;
+class GraphReader;
 
 template <class T>
 concept Intrusive = std::is_base_of_v<RefCounter, T>;
 
+// Allocators for allocate_intrusive; keeps the memory_resource* overload distinct.
+template <class Alloc>
+concept IntrusiveAllocator = requires { typename Alloc::value_type; };
+
+template <class T>
+class IntrusiveWeakPtr;
+
+template <class T>
+class IntrusiveRef;
+
+template <class T, class Hash, class KeyEqual>
+class InternTable;
+
+template <class Pointer>
+struct OwnershipTransfer;
+
 class RefCounter
 {
 public:
     RefCounter() = default;
 
+    // A copy is a new object: it starts with no owners, like a fresh one.
+    RefCounter(const RefCounter&) noexcept
+    {
+    }
+
+    RefCounter& operator=(const RefCounter&) noexcept
+    {
+        return *this;
+    }
 
 #ifdef _DEBUG
     [[nodiscard]] unsigned int GetRefCount() const
     {
-        return ref_count.load();
+        return ref_count.load() & kCountMask;
     }
 #endif
 
     virtual ~RefCounter() = default;
 
+protected:
+    // Frees the object once the last IntrusivePtr is gone. Override it to
+    // return the memory to wherever it came from (see allocate_intrusive).
+    virtual void Destroy()
+    {
+        delete this;
+    }
+
 private:
+    // The top bit of ref_count marks objects that have an entry in the weak
+    // side-table; objects that never get an IntrusiveWeakPtr pay nothing for it.
+    // The next bit marks CycleCollectable objects and the one after that
+    // QueuedDestruction objects.
+    static constexpr unsigned int kWeakFlag = 1u << 31;
+    static constexpr unsigned int kCollectableFlag = 1u << 30;
+    static constexpr unsigned int kQueuedFlag = 1u << 29;
+    static constexpr unsigned int kCountMask = kQueuedFlag - 1;
+
     std::atomic_uint ref_count = 0;
 
-    void AddRef()
+    // Outstanding IntrusiveRef borrows; the object must not die while any exist.
+    // Only _DEBUG builds count them, but the member is always there so the
+    // layout does not depend on the macro.
+    std::atomic_uint borrow_count = 0;
+
+    // Returns the count before the increment.
+    unsigned int AddRef()
     {
-        ref_count.fetch_add(1);
+        SP_CONTENTION_BEGIN(timing, typeid(*this).name());
+        const unsigned int previous = ref_count.fetch_add(1);
+        SP_CONTENTION_END(timing, this, AddRef);
+        return previous & kCountMask;
     }
 
-    void Release()
+    // Increments the count unless it already dropped to zero.
+    bool TryAddRef()
     {
-        if (ref_count.fetch_sub(1) == 1)
+        unsigned int count = ref_count.load();
+        while ((count & kCountMask) != 0)
         {
-            delete this;
+            if (ref_count.compare_exchange_weak(count, count + 1))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns true if this call dropped the last reference. The object is gone
+    // unless it is a QueuedDestruction whose destruction was deferred.
+    bool Release()
+    {
+        // A decrement that leaves the count above zero may orphan a cycle. The
+        // candidate is buffered while this reference still keeps it alive.
+        const unsigned int current = ref_count.load(std::memory_order_relaxed);
+        if ((current & kCollectableFlag) && (current & kCountMask) > 1)
+        {
+            OnPossibleCycleRoot();
         }
+
+        SP_CONTENTION_BEGIN(timing, typeid(*this).name());
+        const unsigned int previous = ref_count.fetch_sub(1);
+        SP_CONTENTION_END(timing, this, Release);
+        if ((previous & kCountMask) == 1)
+        {
+#ifdef _DEBUG
+            assert(borrow_count.load() == 0 && "Object destroyed while borrowed");
+#endif
+            if (previous & kWeakFlag)
+            {
+                ExpireWeakReferences();
+            }
+            // Counted here, by dynamic type, while the object is still alive.
+            SP_INSTRUMENT_OBJECT(this, Destroyed);
+            SP_CENSUS_OBJECT_DESTROYED(this);
+            if (previous & kQueuedFlag)
+            {
+                DestroyQueued();
+            }
+            else
+            {
+                Destroy();
+            }
+            return true;
+        }
+        return false;
     }
 
-    template <Intrusive T>
+    inline void ExpireWeakReferences();
+
+    virtual void OnPossibleCycleRoot()
+    {
+    }
+
+    // Only reached for objects flagged with kQueuedFlag.
+    virtual void DestroyQueued()
+    {
+        Destroy();
+    }
+
+    template <class T>
     friend class IntrusivePtr;
+
+    template <class T>
+    friend class IntrusiveWeakPtr;
+
+    template <class T>
+    friend class IntrusiveRef;
+
+    template <class T, class Hash, class KeyEqual>
+    friend class InternTable;
+
+    friend struct WeakControl;
+    friend class WeakSideTable;
+    friend class CycleCollectable;
+    friend class CycleCollector;
+    friend class QueuedDestruction;
+};
+
+
+// Weak control block of one RefCounter object. It outlives the object while
+// any IntrusiveWeakPtr refers to it. An upgrade announces itself in
+// `upgrading` before it reads `object`; the dying object clears `object` and
+// then waits for announced upgrades to finish before it is deleted. Upgrades
+// never wait for each other or for a lock, and never touch freed memory.
+struct WeakControl
+{
+    std::atomic<RefCounter*> object = nullptr;
+    // One reference per IntrusiveWeakPtr plus one held while the object lives.
+    std::atomic_uint weak_count = 1;
+    // Upgrades between their announcement and their CAS on the object's count.
+    std::atomic_uint upgrading = 0;
+
+    // Raises the object's count unless it already reached zero.
+    bool TryUpgrade()
+    {
+        // Both sides use seq_cst so that either this load sees the cleared
+        // pointer or Expire sees the announcement.
+        upgrading.fetch_add(1);
+        RefCounter* target = object.load();
+        const bool alive = target != nullptr && target->TryAddRef();
+        upgrading.fetch_sub(1, std::memory_order_release);
+        return alive;
+    }
+
+    // Called once the count is zero, before the object is deleted.
+    void Expire()
+    {
+        object.store(nullptr);
+        while (upgrading.load() != 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    void ReleaseWeak()
+    {
+        if (weak_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+};
+
+// Process-wide, lazily populated map from objects to their weak control blocks.
+// Only consulted when a weak reference is created and when an object that had
+// one dies.
+class WeakSideTable
+{
+public:
+    static WeakSideTable& Instance()
+    {
+        // Never destroyed: objects may still expire during static destruction.
+        static WeakSideTable* table = new WeakSideTable();
+        return *table;
+    }
+
+    // Returns the object's control block with an extra weak reference for the caller.
+    WeakControl* Acquire(RefCounter* object)
+    {
+        Shard& shard = ShardFor(object);
+        std::lock_guard guard(shard.mutex);
+        WeakControl*& control = shard.controls[object];
+        if (control == nullptr)
+        {
+            control = new WeakControl();
+            control->object.store(object, std::memory_order_relaxed);
+            object->ref_count.fetch_or(RefCounter::kWeakFlag);
+        }
+        control->weak_count.fetch_add(1, std::memory_order_relaxed);
+        return control;
+    }
+
+    void Expire(RefCounter* object)
+    {
+        WeakControl* control = nullptr;
+        {
+            Shard& shard = ShardFor(object);
+            std::lock_guard guard(shard.mutex);
+            auto it = shard.controls.find(object);
+            if (it == shard.controls.end())
+            {
+                return;
+            }
+            control = it->second;
+            shard.controls.erase(it);
+        }
+        control->Expire();
+        control->ReleaseWeak();
+    }
+
+private:
+    static constexpr std::size_t kShards = 64;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<const RefCounter*, WeakControl*> controls;
+    };
+
+    WeakSideTable() = default;
+
+    Shard& ShardFor(const RefCounter* object)
+    {
+        return shards_[(reinterpret_cast<std::uintptr_t>(object) >> 4) % kShards];
+    }
+
+    std::array<Shard, kShards> shards_;
 };
 
-template <Intrusive Type>
+inline void RefCounter::ExpireWeakReferences()
+{
+    WeakSideTable::Instance().Expire(this);
+}
+
+// The Intrusive requirement is checked in the destructor rather than on the
+// template head, so a type can hold IntrusivePtr members to itself.
+template <class Type>
 class IntrusivePtr
 {
 public:
@@ -63,7 +323,7 @@ public:
         }
 
         ref_ = ref;
-        ref_->AddRef();
+        IncRef(ref_);
     }
 
     IntrusivePtr(const IntrusivePtr<Type>& other)
@@ -73,7 +333,7 @@ public:
             return;
         }
         ref_ = other.ref_;
-        ref_->AddRef();
+        IncRef(ref_);
     }
 
     IntrusivePtr(IntrusivePtr&& other) noexcept
@@ -82,13 +342,26 @@ public:
         other.ref_ = nullptr;
     }
 
+    // Takes the object over from a unique owner with a single AddRef. Only
+    // the default deleter is accepted: from here on Destroy() frees the object.
+    explicit IntrusivePtr(UniquePointer<Type>&& unique)
+    {
+        if (!unique)
+        {
+            return;
+        }
+        ref_ = unique.release();
+        IncRef(ref_);
+    }
+
     //TODO: other constructors...
 
     virtual ~IntrusivePtr()
     {
+        static_assert(Intrusive<Type>, "Type must be derived from RefCounter");
         if (ref_)
         {
-            ref_->Release();
+            DecRef(ref_);
         }
     }
 
@@ -101,7 +374,7 @@ public:
 
         if (ref_)
         {
-            ref_->Release();
+            DecRef(ref_);
         }
 
         if (other.ref_ == nullptr)
@@ -111,7 +384,7 @@ public:
         }
 
         ref_ = other.ref_;
-        ref_->AddRef();
+        IncRef(ref_);
 
         return *this;
     }
@@ -123,6 +396,11 @@ public:
             return *this;
         }
 
+        if (ref_)
+        {
+            DecRef(ref_);
+        }
+
         ref_ = other.ref_;
         other.ref_ = nullptr;
 
@@ -141,7 +419,7 @@ public:
         {
             if (ref_)
             {
-                ref_->Release();
+                DecRef(ref_);
                 ref_ = nullptr;
             }
             return *this;
@@ -149,14 +427,14 @@ public:
 
         if (ref_ != nullptr)
         {
-            ref_->Release();
+            DecRef(ref_);
             ref_ = ref;
-            ref_->AddRef();
+            IncRef(ref_);
         }
         else
         {
             ref_ = ref;
-            ref_->AddRef();
+            IncRef(ref_);
         }
 
         return *this;
@@ -182,11 +460,24 @@ public:
         return ref_;
     }
 
+    [[nodiscard]] unsigned int use_count() const
+    {
+        return ref_ ? ref_->ref_count.load(std::memory_order_relaxed) & RefCounter::kCountMask : 0;
+    }
+
+    // True if this is the only owner. The acquire load orders the caller's
+    // writes after every release made by former owners on other threads, so a
+    // unique object may be mutated in place.
+    [[nodiscard]] bool unique() const
+    {
+        return ref_ && (ref_->ref_count.load(std::memory_order_acquire) & RefCounter::kCountMask) == 1;
+    }
+
     void reset()
     {
         if (ref_)
         {
-            ref_->Release();
+            DecRef(ref_);
             ref_ = nullptr;
         }
     }
@@ -201,7 +492,150 @@ public:
     }
 
 private:
+    struct AdoptTag
+    {
+    };
+
+    // Takes over a reference that the caller already added to the count.
+    IntrusivePtr(Type* ref, AdoptTag) noexcept : ref_(ref)
+    {
+    }
+
+    static void IncRef(Type* ref)
+    {
+        const unsigned int previous = ref->AddRef();
+        SP_INSTRUMENT(Type, AddRef);
+        if (previous == 0)
+        {
+            SP_INSTRUMENT_OBJECT(ref, Created);
+            SP_CENSUS_OBJECT_CREATED(ref);
+        }
+    }
+
+    static void DecRef(Type* ref)
+    {
+        ref->Release();
+        SP_INSTRUMENT(Type, Release);
+    }
+
     Type* ref_ = nullptr;
+
+    template <class T>
+    friend class IntrusiveWeakPtr;
+
+    template <class T, class Hash, class KeyEqual>
+    friend class InternTable;
+
+    template <class Pointer>
+    friend struct OwnershipTransfer;
+
+    friend class CycleTracer;
+    friend class GraphReader;
+};
+
+
+//INTRUSIVE WEAK POINTER
+template <class Type>
+class IntrusiveWeakPtr
+{
+public:
+    IntrusiveWeakPtr() = default;
+
+    explicit IntrusiveWeakPtr(const IntrusivePtr<Type>& strong)
+    {
+        if (strong.ref_ == nullptr)
+        {
+            return;
+        }
+        pointer_ = strong.ref_;
+        control_ = WeakSideTable::Instance().Acquire(pointer_);
+    }
+
+    IntrusiveWeakPtr(const IntrusiveWeakPtr& other) noexcept
+    {
+        pointer_ = other.pointer_;
+        control_ = other.control_;
+        if (control_)
+        {
+            control_->weak_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    IntrusiveWeakPtr(IntrusiveWeakPtr&& other) noexcept
+    {
+        std::swap(pointer_, other.pointer_);
+        std::swap(control_, other.control_);
+    }
+
+    ~IntrusiveWeakPtr()
+    {
+        if (control_)
+        {
+            control_->ReleaseWeak();
+        }
+    }
+
+    IntrusiveWeakPtr& operator=(const IntrusiveWeakPtr& other) noexcept
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        IntrusiveWeakPtr(other).swap(*this);
+        return *this;
+    }
+
+    IntrusiveWeakPtr& operator=(IntrusiveWeakPtr&& other) noexcept
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        IntrusiveWeakPtr(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    IntrusiveWeakPtr& operator=(const IntrusivePtr<Type>& strong)
+    {
+        IntrusiveWeakPtr(strong).swap(*this);
+        return *this;
+    }
+
+    // Strong reference to the object, or an empty pointer if it already died.
+    // The count is raised with a CAS that fails once it has reached zero.
+    [[nodiscard]] IntrusivePtr<Type> upgrade() const
+    {
+        if (control_ == nullptr || !control_->TryUpgrade())
+        {
+            return IntrusivePtr<Type>();
+        }
+        SP_INSTRUMENT(Type, AddRef);
+        return IntrusivePtr<Type>(pointer_, typename IntrusivePtr<Type>::AdoptTag{});
+    }
+
+    [[nodiscard]] bool expired() const
+    {
+        if (control_ == nullptr)
+        {
+            return true;
+        }
+        return control_->object.load(std::memory_order_acquire) == nullptr;
+    }
+
+    void reset()
+    {
+        IntrusiveWeakPtr().swap(*this);
+    }
+
+    void swap(IntrusiveWeakPtr& other) noexcept
+    {
+        std::swap(pointer_, other.pointer_);
+        std::swap(control_, other.control_);
+    }
+
+private:
+    Type* pointer_ = nullptr;
+    WeakControl* control_ = nullptr;
 };
 
 
@@ -211,4 +645,54 @@ static IntrusivePtr<T> make_intrusive(Args&&... args)
     return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
 }
 
+// T allocated from an allocator; Destroy() hands the memory back to it. The
+// allocator is stored in the object, taking no space when it is stateless.
+template <class T, class Alloc>
+class AllocatedIntrusive final : public T
+{
+public:
+    template <class... Args>
+    explicit AllocatedIntrusive(const Alloc& alloc, Args&&... args)
+        : T(std::forward<Args>(args)...), alloc_(alloc)
+    {
+    }
+
+private:
+    using Allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<AllocatedIntrusive>;
+
+    void Destroy() override
+    {
+        Allocator alloc(alloc_);
+        std::allocator_traits<Allocator>::destroy(alloc, this);
+        std::allocator_traits<Allocator>::deallocate(alloc, this, 1);
+    }
+
+    [[no_unique_address]] Alloc alloc_;
+};
+
+template <class T, IntrusiveAllocator Alloc, class... Args>
+static IntrusivePtr<T> allocate_intrusive(const Alloc& alloc, Args&&... args)
+{
+    using Object = AllocatedIntrusive<T, Alloc>;
+    using Allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<Object>;
+    Allocator object_alloc(alloc);
+    Object* object = std::allocator_traits<Allocator>::allocate(object_alloc, 1);
+    try
+    {
+        ::new (static_cast<void*>(object)) Object(alloc, std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        std::allocator_traits<Allocator>::deallocate(object_alloc, object, 1);
+        throw;
+    }
+    return IntrusivePtr<T>(object);
+}
+
+template <class T, class... Args>
+static IntrusivePtr<T> allocate_intrusive(std::pmr::memory_resource* resource, Args&&... args)
+{
+    return allocate_intrusive<T>(std::pmr::polymorphic_allocator<T>(resource), std::forward<Args>(args)...);
+}
+
 #endif //INTRUSIVEPTR_H
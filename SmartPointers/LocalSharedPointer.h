@@ -0,0 +1,429 @@
+#ifndef LOCALSHAREDPOINTER_H
+#define LOCALSHAREDPOINTER_H
+
+#include <assert.h>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include "SharedPointer.h"
+
+// Shared ownership for objects that stay on one thread. Copies and releases
+// of a LocalSharedPointer touch plain integer counts. The group of local
+// owners holds a single strong reference in the object's SharedControlBlock,
+// so ToShared() hands the object to another thread with one atomic increment,
+// and the object lives until both the local group and every escaped
+// SharedPointer are gone.
+//
+// MakeLocalShared() puts the local counts, the shared counts and the object
+// in one allocation, and starting the group costs no atomic operation. A
+// group started from an existing SharedPointer allocates only the local counts.
+//
+// In _DEBUG builds every count operation asserts that it runs on the thread
+// that created the group. The creating thread is recorded in every build, so
+// the block has the same layout with and without the macro.
+
+template <class Type>
+class LocalSharedPointer;
+
+template <class Type>
+class LocalWeakPointer;
+
+template <class Type>
+class LocalControlBlock
+{
+public:
+    // Takes over the strong reference shared holds.
+    static LocalControlBlock* Adopt(SharedPointer<Type>&& shared)
+    {
+        auto* block = new LocalControlBlock(shared.control_, &DeleteSeparate);
+        shared.pointer_ = nullptr;
+        shared.control_ = nullptr;
+        return block;
+    }
+
+    void AssertOwner() const
+    {
+#ifdef _DEBUG
+        assert(owner == std::this_thread::get_id() && "Local shared pointer used from another thread");
+#endif
+    }
+
+    void AddRef()
+    {
+        AssertOwner();
+        ++strong;
+    }
+
+    void Release()
+    {
+        AssertOwner();
+        if (--strong == 0)
+        {
+            SharedRelease<Type>(shared);
+            ReleaseWeak();
+        }
+    }
+
+    void AddWeak()
+    {
+        AssertOwner();
+        ++weak;
+    }
+
+    void ReleaseWeak()
+    {
+        AssertOwner();
+        if (--weak != 0)
+        {
+            return;
+        }
+        free_(this);
+    }
+
+    [[nodiscard]] SharedPointer<Type> ToShared(Type* pointer) const
+    {
+        AssertOwner();
+        SharedAddRef<Type>(shared);
+        return SharedPointer<Type>(pointer, shared, typename SharedPointer<Type>::AdoptTag{});
+    }
+
+    unsigned int strong = 1;
+    // One per LocalWeakPointer plus one held while strong > 0.
+    unsigned int weak = 1;
+    // Holds one strong reference while strong > 0.
+    SharedControlBlock* shared;
+    std::thread::id owner = std::this_thread::get_id();
+
+private:
+    using Free = void (*)(LocalControlBlock*) noexcept;
+
+    LocalControlBlock(SharedControlBlock* shared, Free free) : shared(shared), free_(free)
+    {
+    }
+
+    static void DeleteSeparate(LocalControlBlock* block) noexcept
+    {
+        delete block;
+    }
+
+    // Inline counts go away with the shared block, which keeps a weak
+    // reference for them.
+    static void ReleaseInline(LocalControlBlock* block) noexcept
+    {
+        block->shared->ReleaseWeak();
+    }
+
+    // Frees the counts once weak reaches zero; chosen by how they were allocated.
+    Free free_;
+
+    template <class Other>
+    friend class LocalInplaceBlock;
+};
+
+// Block created by MakeLocalShared: shared counts, local counts and the object
+// in one allocation.
+template <class Type>
+class LocalInplaceBlock final : public SharedControlBlock
+{
+public:
+    template <class... Args>
+    static LocalInplaceBlock* Create(Args&&... args)
+    {
+        return new LocalInplaceBlock(std::forward<Args>(args)...);
+    }
+
+    Type* object() noexcept
+    {
+        return std::launder(reinterpret_cast<Type*>(storage_));
+    }
+
+    void Destroy() noexcept override
+    {
+        SP_INSTRUMENT(Type, Destroyed);
+        SP_CENSUS_DESTROYED(Type, object());
+        std::destroy_at(object());
+    }
+
+    void Deallocate() noexcept override
+    {
+        delete this;
+    }
+
+    LocalControlBlock<Type> local{this, &LocalControlBlock<Type>::ReleaseInline};
+
+private:
+    template <class... Args>
+    explicit LocalInplaceBlock(Args&&... args)
+    {
+        ::new (static_cast<void*>(storage_)) Type(std::forward<Args>(args)...);
+        // The local counts hold one weak reference until they are released.
+        weak.store(2, std::memory_order_relaxed);
+    }
+
+    alignas(Type) std::byte storage_[sizeof(Type)];
+};
+
+
+//LOCAL SHARED POINTER
+template <class Type>
+class LocalSharedPointer
+{
+public:
+    constexpr LocalSharedPointer() noexcept = default;
+
+    explicit LocalSharedPointer(Type* ptr) : LocalSharedPointer(SharedPointer<Type>(ptr))
+    {
+    }
+
+    // Starts a local group that owns one reference of shared.
+    explicit LocalSharedPointer(SharedPointer<Type> shared)
+    {
+        if (!shared)
+        {
+            return;
+        }
+        pointer_ = shared.get();
+        control_ = LocalControlBlock<Type>::Adopt(std::move(shared));
+    }
+
+    LocalSharedPointer(const LocalSharedPointer& other)
+    {
+        if (other.control_ == nullptr)
+        {
+            return;
+        }
+        other.control_->AddRef();
+        pointer_ = other.pointer_;
+        control_ = other.control_;
+    }
+
+    LocalSharedPointer(LocalSharedPointer&& other) noexcept
+    {
+        swap(other);
+    }
+
+    ~LocalSharedPointer()
+    {
+        if (control_)
+        {
+            control_->Release();
+        }
+    }
+
+    LocalSharedPointer& operator=(const LocalSharedPointer& other)
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        LocalSharedPointer(other).swap(*this);
+        return *this;
+    }
+
+    LocalSharedPointer& operator=(LocalSharedPointer&& other) noexcept
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        LocalSharedPointer(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    Type* operator->() const
+    {
+        return pointer_;
+    }
+
+    Type& operator*() const
+    {
+        return *pointer_;
+    }
+
+    explicit operator bool() const
+    {
+        return pointer_ != nullptr;
+    }
+
+    bool operator==(const LocalSharedPointer& other) const
+    {
+        return pointer_ == other.pointer_;
+    }
+
+    bool operator!=(const LocalSharedPointer& other) const
+    {
+        return pointer_ != other.pointer_;
+    }
+
+    Type* get() const
+    {
+        return pointer_;
+    }
+
+    // Number of local owners; escaped SharedPointers are not included.
+    [[nodiscard]] std::size_t use_count() const
+    {
+        return control_ ? control_->strong : 0;
+    }
+
+    [[nodiscard]] bool unique() const
+    {
+        return use_count() == 1;
+    }
+
+    // Thread-safe owner of the same object, for handing it to another thread.
+    [[nodiscard]] SharedPointer<Type> ToShared() const
+    {
+        if (control_ == nullptr)
+        {
+            return SharedPointer<Type>();
+        }
+        return control_->ToShared(pointer_);
+    }
+
+    void reset()
+    {
+        LocalSharedPointer().swap(*this);
+    }
+
+    void swap(LocalSharedPointer& other) noexcept
+    {
+        std::swap(pointer_, other.pointer_);
+        std::swap(control_, other.control_);
+    }
+
+private:
+    LocalSharedPointer(Type* ptr, LocalControlBlock<Type>* control) noexcept : pointer_(ptr), control_(control)
+    {
+    }
+
+    Type* pointer_ = nullptr;
+    LocalControlBlock<Type>* control_ = nullptr;
+
+    friend class LocalWeakPointer<Type>;
+
+    template <class T, class... Args>
+    friend LocalSharedPointer<T> MakeLocalShared(Args&&... args);
+};
+
+
+//LOCAL WEAK POINTER
+template <class Type>
+class LocalWeakPointer
+{
+public:
+    constexpr LocalWeakPointer() noexcept = default;
+
+    explicit LocalWeakPointer(const LocalSharedPointer<Type>& shared)
+    {
+        if (shared.control_ == nullptr)
+        {
+            return;
+        }
+        shared.control_->AddWeak();
+        pointer_ = shared.pointer_;
+        control_ = shared.control_;
+    }
+
+    LocalWeakPointer(const LocalWeakPointer& other)
+    {
+        if (other.control_ == nullptr)
+        {
+            return;
+        }
+        other.control_->AddWeak();
+        pointer_ = other.pointer_;
+        control_ = other.control_;
+    }
+
+    LocalWeakPointer(LocalWeakPointer&& other) noexcept
+    {
+        swap(other);
+    }
+
+    ~LocalWeakPointer()
+    {
+        if (control_)
+        {
+            control_->ReleaseWeak();
+        }
+    }
+
+    LocalWeakPointer& operator=(const LocalWeakPointer& other)
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        LocalWeakPointer(other).swap(*this);
+        return *this;
+    }
+
+    LocalWeakPointer& operator=(LocalWeakPointer&& other) noexcept
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        LocalWeakPointer(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    [[nodiscard]] bool expired() const
+    {
+        return use_count() == 0;
+    }
+
+    [[nodiscard]] std::size_t use_count() const
+    {
+        return control_ ? control_->strong : 0;
+    }
+
+    // Expired once the last local owner is gone, even if escaped
+    // SharedPointers still keep the object alive.
+    LocalSharedPointer<Type> lock() const
+    {
+        LocalSharedPointer<Type> locked;
+        if (control_ != nullptr && control_->strong != 0)
+        {
+            control_->AddRef();
+            locked.pointer_ = pointer_;
+            locked.control_ = control_;
+        }
+        return locked;
+    }
+
+    void reset()
+    {
+        LocalWeakPointer().swap(*this);
+    }
+
+    void swap(LocalWeakPointer& other) noexcept
+    {
+        std::swap(pointer_, other.pointer_);
+        std::swap(control_, other.control_);
+    }
+
+private:
+    Type* pointer_ = nullptr;
+    LocalControlBlock<Type>* control_ = nullptr;
+};
+
+
+// Like AllocateShared, the object is not registered for adoption, so it must
+// not be passed to SharedPointer(Type*) again.
+template <class T, class... Args>
+LocalSharedPointer<T> MakeLocalShared(Args&&... args)
+{
+    auto* block = LocalInplaceBlock<T>::Create(std::forward<Args>(args)...);
+    BindWeakThis(block->object(), block);
+    SP_INSTRUMENT(T, Created);
+    SP_INSTRUMENT(T, AddRef);
+    SP_CENSUS_CREATED(T, block->object());
+    return LocalSharedPointer<T>(block->object(), &block->local);
+}
+
+#endif //LOCALSHAREDPOINTER_H
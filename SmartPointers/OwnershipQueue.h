@@ -0,0 +1,256 @@
+#ifndef OWNERSHIPQUEUE_H
+#define OWNERSHIPQUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "IntrusivePtr.h"
+#include "SharedPointer.h"
+
+// Bounded lock-free queues that hand a pointer's reference from one thread
+// to another. TryPush() detaches the raw reference from the caller's pointer
+// and TryPop() adopts it into the receiver's, so a message crosses the queue
+// without touching its count. Elements still queued when a queue is destroyed
+// are released by the destructor.
+//
+// SpscQueue is a ring with one producer and one consumer; each side caches
+// the other's index and reads it again only when the ring looks full or
+// empty. MpmcQueue accepts any number of producers and consumers and uses a
+// per-cell sequence number (the D. Vyukov bounded queue).
+//
+// Capacities are rounded up to a power of two.
+
+
+// Moves one reference between a pointer and a trivially copyable raw form.
+template <class T>
+struct OwnershipTransfer<IntrusivePtr<T>>
+{
+    using Raw = T*;
+
+    static Raw Detach(IntrusivePtr<T>& pointer) noexcept
+    {
+        return std::exchange(pointer.ref_, nullptr);
+    }
+
+    static IntrusivePtr<T> Adopt(Raw raw) noexcept
+    {
+        return IntrusivePtr<T>(raw, typename IntrusivePtr<T>::AdoptTag{});
+    }
+};
+
+template <class T>
+struct OwnershipTransfer<SharedPointer<T>>
+{
+    struct Raw
+    {
+        T* pointer = nullptr;
+        SharedControlBlock* control = nullptr;
+    };
+
+    static Raw Detach(SharedPointer<T>& pointer) noexcept
+    {
+        return Raw{std::exchange(pointer.pointer_, nullptr), std::exchange(pointer.control_, nullptr)};
+    }
+
+    static SharedPointer<T> Adopt(Raw raw) noexcept
+    {
+        return SharedPointer<T>(raw.pointer, raw.control, typename SharedPointer<T>::AdoptTag{});
+    }
+};
+
+
+//SINGLE PRODUCER, SINGLE CONSUMER
+template <class Pointer>
+class SpscQueue
+{
+    using Transfer = OwnershipTransfer<Pointer>;
+    using Raw = typename Transfer::Raw;
+
+public:
+    explicit SpscQueue(std::size_t capacity)
+        : mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1), slots_(std::make_unique<Raw[]>(mask_ + 1))
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    ~SpscQueue()
+    {
+        Pointer dropped;
+        while (TryPop(dropped))
+        {
+        }
+    }
+
+    // Producer only. On success value is left empty; on a full queue it is untouched.
+    bool TryPush(Pointer&& value) noexcept
+    {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ > mask_)
+        {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ > mask_)
+            {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = Transfer::Detach(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. The previous value of out is released.
+    bool TryPop(Pointer& out) noexcept
+    {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_)
+        {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_)
+            {
+                return false;
+            }
+        }
+        Pointer value = Transfer::Adopt(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        out = std::move(value);
+        return true;
+    }
+
+    [[nodiscard]] std::size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+private:
+    // Consumer side.
+    alignas(64) std::atomic<std::size_t> head_ = 0;
+    std::size_t tail_cache_ = 0;
+
+    // Producer side.
+    alignas(64) std::atomic<std::size_t> tail_ = 0;
+    std::size_t head_cache_ = 0;
+
+    alignas(64) const std::size_t mask_;
+    const std::unique_ptr<Raw[]> slots_;
+};
+
+
+//MULTI PRODUCER, MULTI CONSUMER
+template <class Pointer>
+class MpmcQueue
+{
+    using Transfer = OwnershipTransfer<Pointer>;
+    using Raw = typename Transfer::Raw;
+
+    struct Cell
+    {
+        // Equals the position a producer may fill next, or that position + 1
+        // once it holds a value for the consumer of that position.
+        std::atomic<std::size_t> sequence;
+        Raw value;
+    };
+
+public:
+    explicit MpmcQueue(std::size_t capacity)
+        : mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1), cells_(std::make_unique<Cell[]>(mask_ + 1))
+    {
+        for (std::size_t i = 0; i <= mask_; ++i)
+        {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    ~MpmcQueue()
+    {
+        Pointer dropped;
+        while (TryPop(dropped))
+        {
+        }
+    }
+
+    // On success value is left empty; on a full queue it is untouched.
+    bool TryPush(Pointer&& value) noexcept
+    {
+        std::size_t position = tail_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &cells_[position & mask_];
+            const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<std::intptr_t>(sequence - position);
+            if (difference == 0)
+            {
+                if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = Transfer::Detach(value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // The previous value of out is released.
+    bool TryPop(Pointer& out) noexcept
+    {
+        std::size_t position = head_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &cells_[position & mask_];
+            const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<std::intptr_t>(sequence - (position + 1));
+            if (difference == 0)
+            {
+                if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = head_.load(std::memory_order_relaxed);
+            }
+        }
+        Pointer value = Transfer::Adopt(cell->value);
+        cell->sequence.store(position + mask_ + 1, std::memory_order_release);
+        out = std::move(value);
+        return true;
+    }
+
+    [[nodiscard]] std::size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+private:
+    alignas(64) std::atomic<std::size_t> head_ = 0;
+    alignas(64) std::atomic<std::size_t> tail_ = 0;
+    alignas(64) const std::size_t mask_;
+    const std::unique_ptr<Cell[]> cells_;
+};
+
+#endif //OWNERSHIPQUEUE_H
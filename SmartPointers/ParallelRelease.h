@@ -0,0 +1,86 @@
+#ifndef PARALLELRELEASE_H
+#define PARALLELRELEASE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include <thread>
+#include <vector>
+
+// Releases every pointer of a large range on several threads. Dropping tens
+// of millions of owners one after another is bound by the decrements, the
+// destructors and the frees; here the range is cut into fixed blocks that
+// the calling thread and threads - 1 workers claim from a shared counter, so
+// slow destructors in one part of the range do not hold the others back.
+//
+// Each element is reset() on whichever thread claims its block. Objects that
+// are shared between elements are still released exactly once: the last
+// decrement, on any thread, runs the destructor. Ranges shorter than
+// kMinParallelRelease are released on the calling thread.
+//
+// Works for any pointer with reset(): IntrusivePtr, SharedPointer,
+// UniquePointer and the std smart pointers. Frees from threads other than the
+// allocating one may contend inside the allocator; the speedup depends on it.
+
+constexpr std::size_t kMinParallelRelease = 1 << 14;
+constexpr std::size_t kReleaseBlock = 1 << 12;
+
+// Resets every element of range; the elements stay in place, now empty.
+template <std::ranges::random_access_range Range>
+    requires std::ranges::sized_range<Range>
+void ParallelRelease(Range&& range, unsigned int threads = std::thread::hardware_concurrency())
+{
+    const auto first = std::ranges::begin(range);
+    const std::size_t size = std::ranges::size(range);
+    const std::size_t blocks = (size + kReleaseBlock - 1) / kReleaseBlock;
+    threads = static_cast<unsigned int>(std::min<std::size_t>(std::max(threads, 1u), blocks));
+
+    if (threads <= 1 || size < kMinParallelRelease)
+    {
+        for (auto it = first; it != first + size; ++it)
+        {
+            it->reset();
+        }
+        return;
+    }
+
+    std::atomic<std::size_t> next_block = 0;
+    auto work = [&]
+    {
+        for (;;)
+        {
+            const std::size_t block = next_block.fetch_add(1, std::memory_order_relaxed);
+            if (block >= blocks)
+            {
+                return;
+            }
+            const std::size_t begin = block * kReleaseBlock;
+            const std::size_t end = std::min(begin + kReleaseBlock, size);
+            for (auto it = first + begin; it != first + end; ++it)
+            {
+                it->reset();
+            }
+        }
+    };
+
+    std::vector<std::jthread> workers;
+    workers.reserve(threads - 1);
+    for (unsigned int i = 1; i < threads; ++i)
+    {
+        workers.emplace_back(work);
+    }
+    work();
+}
+
+// Releases the elements in parallel, then clears the now empty container.
+template <class Container>
+    requires std::ranges::random_access_range<Container&> && std::ranges::sized_range<Container&>
+void ParallelClear(Container& container, unsigned int threads = std::thread::hardware_concurrency())
+{
+    ParallelRelease(container, threads);
+    container.clear();
+}
+
+#endif //PARALLELRELEASE_H
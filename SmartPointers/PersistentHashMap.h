@@ -0,0 +1,240 @@
+#ifndef PERSISTENTHASHMAP_H
+#define PERSISTENTHASHMAP_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "IntrusivePtr.h"
+
+// Persistent hash map: a hash array mapped trie of RefCounter nodes. Each
+// level consumes five bits of the hash and stores only its occupied slots,
+// each either an entry or a child node; keys whose hashes agree in every bit
+// share a collision node at the bottom. Copies are O(1) snapshots.
+//
+// As in PersistentVector, updates copy only the nodes that are shared with
+// another map and change uniquely owned nodes in place.
+
+template <class Key, class Value, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>>
+class PersistentHashMap
+{
+public:
+    PersistentHashMap() = default;
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return size_;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    // Pointer to the value stored for key, or nullptr.
+    [[nodiscard]] const Value* find(const Key& key) const
+    {
+        const std::size_t hash = Hash{}(key);
+        const Node* node = root_.get();
+        for (unsigned int shift = 0; node != nullptr; shift += kBits)
+        {
+            if (shift >= kHashBits)
+            {
+                for (const Slot& slot : node->slots)
+                {
+                    const Entry& entry = std::get<Entry>(slot);
+                    if (KeyEqual{}(entry.key, key))
+                    {
+                        return &entry.value;
+                    }
+                }
+                return nullptr;
+            }
+            const std::uint32_t bit = Bit(hash, shift);
+            if ((node->bitmap & bit) == 0)
+            {
+                return nullptr;
+            }
+            const Slot& slot = node->slots[Index(node->bitmap, bit)];
+            if (const Entry* entry = std::get_if<Entry>(&slot))
+            {
+                return entry->hash == hash && KeyEqual{}(entry->key, key) ? &entry->value : nullptr;
+            }
+            node = std::get<IntrusivePtr<Node>>(slot).get();
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] bool contains(const Key& key) const
+    {
+        return find(key) != nullptr;
+    }
+
+    // Inserts key or replaces its value. Returns true if key was new.
+    bool set(Key key, Value value)
+    {
+        if (!root_)
+        {
+            root_ = IntrusivePtr<Node>(new Node());
+        }
+        const std::size_t hash = Hash{}(key);
+        const bool inserted = Set(root_, 0, Entry{hash, std::move(key), std::move(value)});
+        size_ += inserted;
+        return inserted;
+    }
+
+    // Returns true if key was present.
+    bool erase(const Key& key)
+    {
+        // Checked first so a miss does not copy the path.
+        if (!contains(key))
+        {
+            return false;
+        }
+        Erase(root_, 0, Hash{}(key), key);
+        --size_;
+        return true;
+    }
+
+    void swap(PersistentHashMap& other) noexcept
+    {
+        root_.swap(other.root_);
+        std::swap(size_, other.size_);
+    }
+
+private:
+    static constexpr unsigned int kBits = 5;
+    static constexpr unsigned int kHashBits = sizeof(std::size_t) * 8;
+
+    struct Node;
+
+    struct Entry
+    {
+        std::size_t hash;
+        Key key;
+        Value value;
+    };
+
+    using Slot = std::variant<Entry, IntrusivePtr<Node>>;
+
+    // Below kHashBits, slots are ordered by the hash bits set in bitmap.
+    // At the bottom, bitmap is unused and slots is a list of colliding entries.
+    struct Node : RefCounter
+    {
+        std::uint32_t bitmap = 0;
+        std::vector<Slot> slots;
+    };
+
+    static std::uint32_t Bit(std::size_t hash, unsigned int shift)
+    {
+        return std::uint32_t{1} << ((hash >> shift) & 31);
+    }
+
+    static std::size_t Index(std::uint32_t bitmap, std::uint32_t bit)
+    {
+        return static_cast<std::size_t>(std::popcount(bitmap & (bit - 1)));
+    }
+
+    static Node& Mutable(IntrusivePtr<Node>& node)
+    {
+        if (!node.unique())
+        {
+            node = IntrusivePtr<Node>(new Node(*node));
+        }
+        return *node;
+    }
+
+    static bool Set(IntrusivePtr<Node>& node_ptr, unsigned int shift, Entry entry)
+    {
+        Node& node = Mutable(node_ptr);
+        if (shift >= kHashBits)
+        {
+            for (Slot& slot : node.slots)
+            {
+                Entry& existing = std::get<Entry>(slot);
+                if (KeyEqual{}(existing.key, entry.key))
+                {
+                    existing.value = std::move(entry.value);
+                    return false;
+                }
+            }
+            node.slots.emplace_back(std::move(entry));
+            return true;
+        }
+
+        const std::uint32_t bit = Bit(entry.hash, shift);
+        const std::size_t index = Index(node.bitmap, bit);
+        if ((node.bitmap & bit) == 0)
+        {
+            node.bitmap |= bit;
+            node.slots.emplace(node.slots.begin() + static_cast<std::ptrdiff_t>(index), std::move(entry));
+            return true;
+        }
+
+        Slot& slot = node.slots[index];
+        if (auto* child = std::get_if<IntrusivePtr<Node>>(&slot))
+        {
+            return Set(*child, shift + kBits, std::move(entry));
+        }
+        Entry& existing = std::get<Entry>(slot);
+        if (existing.hash == entry.hash && KeyEqual{}(existing.key, entry.key))
+        {
+            existing.value = std::move(entry.value);
+            return false;
+        }
+
+        // Two keys share this slot: both move one level down.
+        IntrusivePtr<Node> child(new Node());
+        Set(child, shift + kBits, std::move(existing));
+        Set(child, shift + kBits, std::move(entry));
+        slot = std::move(child);
+        return true;
+    }
+
+    // The key is known to be present.
+    static void Erase(IntrusivePtr<Node>& node_ptr, unsigned int shift, std::size_t hash, const Key& key)
+    {
+        Node& node = Mutable(node_ptr);
+        if (shift >= kHashBits)
+        {
+            for (auto it = node.slots.begin(); it != node.slots.end(); ++it)
+            {
+                if (KeyEqual{}(std::get<Entry>(*it).key, key))
+                {
+                    node.slots.erase(it);
+                    return;
+                }
+            }
+            return;
+        }
+
+        const std::uint32_t bit = Bit(hash, shift);
+        const auto index = static_cast<std::ptrdiff_t>(Index(node.bitmap, bit));
+        Slot& slot = node.slots[static_cast<std::size_t>(index)];
+        auto* child = std::get_if<IntrusivePtr<Node>>(&slot);
+        if (child == nullptr)
+        {
+            node.bitmap &= ~bit;
+            node.slots.erase(node.slots.begin() + index);
+            return;
+        }
+
+        Erase(*child, shift + kBits, hash, key);
+        // A child left holding a single entry is folded back into this level.
+        Node& remaining = **child;
+        if (remaining.slots.size() == 1 && std::holds_alternative<Entry>(remaining.slots.front()))
+        {
+            Entry entry = std::move(std::get<Entry>(remaining.slots.front()));
+            slot = std::move(entry);
+        }
+    }
+
+    IntrusivePtr<Node> root_;
+    std::size_t size_ = 0;
+};
+
+#endif //PERSISTENTHASHMAP_H
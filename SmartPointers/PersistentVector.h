@@ -0,0 +1,234 @@
+#ifndef PERSISTENTVECTOR_H
+#define PERSISTENTVECTOR_H
+
+#include <assert.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include "IntrusivePtr.h"
+
+// Persistent vector: a 32-way trie of RefCounter nodes plus a tail leaf that
+// takes appends until it is full. Copying the vector copies one pointer, so
+// snapshots are O(1) and share every node.
+//
+// Updates copy the path from the root to the changed leaf, except where a node
+// is owned only by the vector being updated: such nodes are changed in place.
+// A batch of updates to a vector nobody else has snapshotted therefore
+// allocates only for growth, and after a snapshot each node on a path is
+// copied at most once.
+
+template <class T>
+class PersistentVector
+{
+public:
+    static constexpr unsigned int kBits = 5;
+    static constexpr std::size_t kWidth = std::size_t{1} << kBits;
+    static constexpr std::size_t kMask = kWidth - 1;
+
+    PersistentVector() = default;
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return size_;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    const T& operator[](std::size_t index) const
+    {
+        assert(index < size_ && "PersistentVector index out of range");
+        return LeafFor(index).Get(index & kMask);
+    }
+
+    void push_back(T value)
+    {
+        if (size_ - TailOffset() < kWidth)
+        {
+            if (!tail_)
+            {
+                tail_ = IntrusivePtr<Node>(new Leaf());
+            }
+            Mutable<Leaf>(tail_).Append(std::move(value));
+            ++size_;
+            return;
+        }
+
+        // The tail is full: it moves into the trie and a new one starts.
+        if ((size_ >> kBits) > (std::size_t{1} << shift_))
+        {
+            auto* root = new Branch();
+            root->children[0] = std::move(root_);
+            root->children[1] = NewPath(shift_, std::move(tail_));
+            root_ = IntrusivePtr<Node>(root);
+            shift_ += kBits;
+        }
+        else
+        {
+            PushTail(root_, shift_, std::move(tail_));
+        }
+        auto* tail = new Leaf();
+        tail->Append(std::move(value));
+        tail_ = IntrusivePtr<Node>(tail);
+        ++size_;
+    }
+
+    void set(std::size_t index, T value)
+    {
+        assert(index < size_ && "PersistentVector index out of range");
+        if (index >= TailOffset())
+        {
+            Mutable<Leaf>(tail_).Get(index & kMask) = std::move(value);
+            return;
+        }
+        IntrusivePtr<Node>* node = &root_;
+        for (unsigned int level = shift_; level > 0; level -= kBits)
+        {
+            node = &Mutable<Branch>(*node).children[(index >> level) & kMask];
+        }
+        Mutable<Leaf>(*node).Get(index & kMask) = std::move(value);
+    }
+
+    void swap(PersistentVector& other) noexcept
+    {
+        root_.swap(other.root_);
+        tail_.swap(other.tail_);
+        std::swap(size_, other.size_);
+        std::swap(shift_, other.shift_);
+    }
+
+private:
+    struct Node : RefCounter
+    {
+    };
+
+    struct Branch : Node
+    {
+        std::array<IntrusivePtr<Node>, kWidth> children;
+    };
+
+    struct Leaf : Node
+    {
+        Leaf() = default;
+
+        Leaf(const Leaf& other) : Node(other)
+        {
+            for (; count < other.count; ++count)
+            {
+                ::new (Slot(count)) T(other.Get(count));
+            }
+        }
+
+        Leaf& operator=(const Leaf&) = delete;
+
+        ~Leaf() override
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                Get(i).~T();
+            }
+        }
+
+        void Append(T value)
+        {
+            ::new (Slot(count)) T(std::move(value));
+            ++count;
+        }
+
+        T& Get(std::size_t i)
+        {
+            return *std::launder(reinterpret_cast<T*>(Slot(i)));
+        }
+
+        const T& Get(std::size_t i) const
+        {
+            return *std::launder(reinterpret_cast<const T*>(storage + i * sizeof(T)));
+        }
+
+        void* Slot(std::size_t i)
+        {
+            return storage + i * sizeof(T);
+        }
+
+        std::size_t count = 0;
+        alignas(T) unsigned char storage[kWidth * sizeof(T)];
+    };
+
+    // Makes node safe to change: a node with other owners is replaced by a
+    // private copy, which shares the children of the original.
+    template <class Kind>
+    static Kind& Mutable(IntrusivePtr<Node>& node)
+    {
+        if (!node.unique())
+        {
+            node = IntrusivePtr<Node>(new Kind(static_cast<const Kind&>(*node)));
+        }
+        return static_cast<Kind&>(*node);
+    }
+
+    // Index of the first element held by the tail.
+    [[nodiscard]] std::size_t TailOffset() const
+    {
+        return size_ < kWidth ? 0 : ((size_ - 1) >> kBits) << kBits;
+    }
+
+    const Leaf& LeafFor(std::size_t index) const
+    {
+        if (index >= TailOffset())
+        {
+            return static_cast<const Leaf&>(*tail_);
+        }
+        const Node* node = root_.get();
+        for (unsigned int level = shift_; level > 0; level -= kBits)
+        {
+            node = static_cast<const Branch*>(node)->children[(index >> level) & kMask].get();
+        }
+        return static_cast<const Leaf&>(*node);
+    }
+
+    static IntrusivePtr<Node> NewPath(unsigned int level, IntrusivePtr<Node> leaf)
+    {
+        for (; level > 0; level -= kBits)
+        {
+            auto* branch = new Branch();
+            branch->children[0] = std::move(leaf);
+            leaf = IntrusivePtr<Node>(branch);
+        }
+        return leaf;
+    }
+
+    // Hangs the full tail off the rightmost path, copying only shared nodes.
+    void PushTail(IntrusivePtr<Node>& root, unsigned int level, IntrusivePtr<Node> leaf)
+    {
+        if (!root)
+        {
+            root = NewPath(level, std::move(leaf));
+            return;
+        }
+        const std::size_t last = size_ - 1;
+        IntrusivePtr<Node>* node = &root;
+        for (; level > kBits; level -= kBits)
+        {
+            IntrusivePtr<Node>& child = Mutable<Branch>(*node).children[(last >> level) & kMask];
+            if (!child)
+            {
+                child = NewPath(level - kBits, std::move(leaf));
+                return;
+            }
+            node = &child;
+        }
+        Mutable<Branch>(*node).children[(last >> level) & kMask] = std::move(leaf);
+    }
+
+    IntrusivePtr<Node> root_;
+    IntrusivePtr<Node> tail_;
+    std::size_t size_ = 0;
+    unsigned int shift_ = kBits;
+};
+
+#endif //PERSISTENTVECTOR_H
@@ -0,0 +1,157 @@
+#ifndef QUEUEDDESTRUCTION_H
+#define QUEUEDDESTRUCTION_H
+
+#include <cstddef>
+#include <limits>
+
+#include "IntrusivePtr.h"
+
+// Opt-in iterative destruction. Dropping the head of a long chain normally
+// recurses: the destructor releases the next node, whose destructor releases
+// the one after, one stack frame group per node. Objects derived from
+// QueuedDestruction instead join a per-thread queue when their last reference
+// goes away. The outermost release drains it in a loop, and a release made
+// while draining (from inside a destructor) only enqueues, so the stack stays
+// flat however long the chain is.
+//
+// Weak references expire at the last release as usual; only the destructor
+// and the free are deferred.
+//
+// SetReleaseBudget(n) caps how many objects one outermost release destroys;
+// the rest stay queued for the next release or an explicit Drain() on the
+// same thread. Objects left queued when a thread exits are destroyed then;
+// releases made after that, from other thread_local destructors, destroy
+// their object at once instead of queueing it.
+class QueuedDestruction : public RefCounter
+{
+public:
+    QueuedDestruction()
+    {
+        ref_count.fetch_or(kQueuedFlag, std::memory_order_relaxed);
+    }
+
+    QueuedDestruction(const QueuedDestruction&) noexcept : QueuedDestruction()
+    {
+    }
+
+    QueuedDestruction& operator=(const QueuedDestruction&) noexcept
+    {
+        return *this;
+    }
+
+    // Destroys up to budget objects queued on this thread. Returns how many
+    // are still queued.
+    static std::size_t Drain(std::size_t budget = std::numeric_limits<std::size_t>::max())
+    {
+        if (QueueGone())
+        {
+            return 0;
+        }
+        Queue& queue = LocalQueue();
+        if (queue.draining)
+        {
+            return queue.size;
+        }
+        queue.draining = true;
+        for (std::size_t done = 0; queue.head != nullptr && done < budget; ++done)
+        {
+            QueuedDestruction* object = queue.Pop();
+            object->Destroy();
+        }
+        queue.draining = false;
+        return queue.size;
+    }
+
+    // Objects queued on this thread and not yet destroyed.
+    [[nodiscard]] static std::size_t Pending()
+    {
+        return QueueGone() ? 0 : LocalQueue().size;
+    }
+
+    // Objects one outermost release may destroy on this thread; 0 means no limit.
+    static void SetReleaseBudget(std::size_t budget)
+    {
+        if (!QueueGone())
+        {
+            LocalQueue().budget = budget;
+        }
+    }
+
+private:
+    struct Queue
+    {
+        QueuedDestruction* head = nullptr;
+        QueuedDestruction* tail = nullptr;
+        std::size_t size = 0;
+        std::size_t budget = 0;
+        bool draining = false;
+
+        ~Queue()
+        {
+            budget = 0;
+            Drain();
+            QueueGone() = true;
+        }
+
+        void Push(QueuedDestruction* object)
+        {
+            object->next_queued_ = nullptr;
+            if (tail != nullptr)
+            {
+                tail->next_queued_ = object;
+            }
+            else
+            {
+                head = object;
+            }
+            tail = object;
+            ++size;
+        }
+
+        QueuedDestruction* Pop()
+        {
+            QueuedDestruction* object = head;
+            head = object->next_queued_;
+            if (head == nullptr)
+            {
+                tail = nullptr;
+            }
+            --size;
+            return object;
+        }
+    };
+
+    static Queue& LocalQueue()
+    {
+        thread_local Queue queue;
+        return queue;
+    }
+
+    // Set once this thread's queue has been destroyed. Trivially destructible,
+    // so it stays readable for the rest of thread exit.
+    static bool& QueueGone()
+    {
+        thread_local bool gone = false;
+        return gone;
+    }
+
+    void DestroyQueued() override
+    {
+        if (QueueGone())
+        {
+            Destroy();
+            return;
+        }
+        Queue& queue = LocalQueue();
+        queue.Push(this);
+        if (!queue.draining)
+        {
+            Drain(queue.budget == 0 ? std::numeric_limits<std::size_t>::max() : queue.budget);
+        }
+    }
+
+    // Link in this thread's queue; only used once the count reached zero.
+    QueuedDestruction* next_queued_ = nullptr;
+};
+
+#endif //QUEUEDDESTRUCTION_H
@@ -0,0 +1,622 @@
+#ifndef SHAREDMEMORY_H
+#define SHAREDMEMORY_H
+
+#include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Reference counting across processes (POSIX). A ShmSegment is a memfd or
+// POSIX shm mapping that any number of processes may map, each at its own
+// address. Objects live inside it and link to each other with self-relative
+// OffsetPtrs, so no stored address depends on where the segment is mapped.
+// The count of a ShmRefCounter object is a lock-free atomic inside the
+// segment, shared by every process; whichever process drops the last ShmPtr
+// destroys the object and returns its block to the segment's allocator.
+//
+// RefCounter itself cannot be used here: its virtual functions dispatch
+// through a per-process vtable pointer. Objects in a segment must be
+// non-polymorphic and must not hold raw pointers or process-local handles.
+
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "Counts must be address-free across processes");
+static_assert(std::atomic<std::int64_t>::is_always_lock_free, "Offsets must be address-free across processes");
+
+
+//OFFSET POINTER
+// Pointer stored as the distance from itself to the target, so it stays valid
+// wherever the memory holding both is mapped. 1 encodes null, since no object
+// can start one byte past the pointer's own address.
+template <class T>
+class OffsetPtr
+{
+public:
+    OffsetPtr() = default;
+
+    OffsetPtr(T* ptr) noexcept
+    {
+        Set(ptr);
+    }
+
+    OffsetPtr(const OffsetPtr& other) noexcept
+    {
+        Set(other.get());
+    }
+
+    OffsetPtr& operator=(const OffsetPtr& other) noexcept
+    {
+        Set(other.get());
+        return *this;
+    }
+
+    OffsetPtr& operator=(T* ptr) noexcept
+    {
+        Set(ptr);
+        return *this;
+    }
+
+    T* get() const noexcept
+    {
+        if (offset_ == kNull)
+        {
+            return nullptr;
+        }
+        return reinterpret_cast<T*>(reinterpret_cast<std::uintptr_t>(this) + offset_);
+    }
+
+    T* operator->() const noexcept
+    {
+        return get();
+    }
+
+    T& operator*() const noexcept
+    {
+        return *get();
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return offset_ != kNull;
+    }
+
+private:
+    static constexpr std::ptrdiff_t kNull = 1;
+
+    void Set(T* ptr) noexcept
+    {
+        offset_ = ptr == nullptr
+            ? kNull
+            : static_cast<std::ptrdiff_t>(reinterpret_cast<std::uintptr_t>(ptr) - reinterpret_cast<std::uintptr_t>(this));
+    }
+
+    std::ptrdiff_t offset_ = kNull;
+};
+
+
+template <class T>
+class ShmPtr;
+
+// Base of objects kept in a ShmSegment. Non-virtual on purpose: see above.
+class ShmRefCounter
+{
+public:
+    ShmRefCounter() = default;
+
+    // A copy is a new object with no owners.
+    ShmRefCounter(const ShmRefCounter&) noexcept
+    {
+    }
+
+    ShmRefCounter& operator=(const ShmRefCounter&) noexcept
+    {
+        return *this;
+    }
+
+private:
+    std::atomic<std::uint32_t> ref_count = 0;
+
+    template <class T>
+    friend class ShmPtr;
+
+    friend class ShmSegment;
+};
+
+
+//SHARED MEMORY SEGMENT
+// Allocation uses power-of-two size classes with one free list each, carved
+// from a bump region. A spin lock in the segment guards the lists: a futex
+// wait would not be woken from another process.
+class ShmSegment
+{
+public:
+    // Anonymous segment, backed by memfd on Linux and elsewhere by a POSIX shm
+    // object that is unlinked as soon as it is open. The descriptor is
+    // inherited across fork() and can be passed to unrelated processes over a
+    // Unix socket.
+    static ShmSegment Create(std::size_t size)
+    {
+#ifdef __linux__
+        const int fd = memfd_create("SmartPointers", MFD_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "memfd_create");
+        }
+#else
+        static std::atomic<unsigned int> sequence = 0;
+        int fd = -1;
+        while (fd < 0)
+        {
+            const std::string name = "/SmartPointers." + std::to_string(getpid()) + "." +
+                                     std::to_string(sequence.fetch_add(1, std::memory_order_relaxed));
+            fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd < 0 && errno != EEXIST)
+            {
+                throw std::system_error(errno, std::generic_category(), "shm_open");
+            }
+            if (fd >= 0)
+            {
+                shm_unlink(name.c_str());
+            }
+        }
+#endif
+        return Initialize(fd, size);
+    }
+
+    // Named POSIX shm segment; unlink it with RemoveNamed() when done.
+    static ShmSegment CreateNamed(const char* name, std::size_t size)
+    {
+        const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "shm_open");
+        }
+        return Initialize(fd, size);
+    }
+
+    static ShmSegment OpenNamed(const char* name)
+    {
+        const int fd = shm_open(name, O_RDWR, 0);
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "shm_open");
+        }
+        return Map(fd);
+    }
+
+    static void RemoveNamed(const char* name)
+    {
+        shm_unlink(name);
+    }
+
+    // Maps an existing segment at whatever address the kernel picks. Takes
+    // its own duplicate of fd.
+    static ShmSegment Map(int fd)
+    {
+        struct stat info;
+        const int own = dup(fd);
+        if (own < 0 || fstat(own, &info) != 0)
+        {
+            const int error = errno;
+            if (own >= 0)
+            {
+                close(own);
+            }
+            throw std::system_error(error, std::generic_category(), "ShmSegment::Map");
+        }
+        if (info.st_size < static_cast<off_t>(sizeof(Header)))
+        {
+            close(own);
+            throw std::runtime_error("ShmSegment::Map: not a ShmSegment");
+        }
+        ShmSegment segment(own, static_cast<std::size_t>(info.st_size));
+        if (segment.header().magic != kMagic || segment.header().size > segment.size_)
+        {
+            throw std::runtime_error("ShmSegment::Map: not a ShmSegment");
+        }
+        return segment;
+    }
+
+    ShmSegment(ShmSegment&& other) noexcept
+        : fd_(std::exchange(other.fd_, -1)), base_(std::exchange(other.base_, nullptr)),
+          size_(std::exchange(other.size_, 0))
+    {
+    }
+
+    ShmSegment(const ShmSegment&) = delete;
+    ShmSegment& operator=(const ShmSegment&) = delete;
+    ShmSegment& operator=(ShmSegment&&) = delete;
+
+    // Unmaps the segment in this process. Objects in it are unaffected, and
+    // ShmPtrs into this mapping must not outlive it.
+    ~ShmSegment()
+    {
+        if (base_ != nullptr)
+        {
+            munmap(base_, size_);
+        }
+        if (fd_ >= 0)
+        {
+            close(fd_);
+        }
+    }
+
+    [[nodiscard]] int fd() const
+    {
+        return fd_;
+    }
+
+    [[nodiscard]] std::byte* base() const
+    {
+        return base_;
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return size_;
+    }
+
+    // Bytes in live blocks, counted across every process.
+    [[nodiscard]] std::size_t BytesInUse() const
+    {
+        return header().in_use.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool Contains(const void* ptr) const
+    {
+        const auto* byte = static_cast<const std::byte*>(ptr);
+        return byte >= base_ && byte < base_ + size_;
+    }
+
+    // Blocks are aligned to kBlockAlignment; a stricter alignment throws
+    // std::bad_alloc, as does running out of space.
+    void* Allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t))
+    {
+        if (alignment > kBlockAlignment || size > std::numeric_limits<std::size_t>::max() - sizeof(BlockHeader))
+        {
+            throw std::bad_alloc();
+        }
+        const std::size_t total = size + sizeof(BlockHeader);
+        const unsigned int size_class = std::max<unsigned int>(kMinClass, std::bit_width(total - 1));
+        if (size_class >= kClasses)
+        {
+            throw std::bad_alloc();
+        }
+        Header& head = header();
+        std::int64_t offset = 0;
+        {
+            SpinGuard guard(head.lock);
+            offset = head.free_lists[size_class];
+            if (offset != 0)
+            {
+                head.free_lists[size_class] = *reinterpret_cast<std::int64_t*>(base_ + offset + sizeof(BlockHeader));
+            }
+            else
+            {
+                offset = head.top;
+                if (offset + (std::int64_t{1} << size_class) > static_cast<std::int64_t>(head.size))
+                {
+                    throw std::bad_alloc();
+                }
+                head.top += std::int64_t{1} << size_class;
+            }
+        }
+        head.in_use.fetch_add(std::size_t{1} << size_class, std::memory_order_relaxed);
+        auto* block = ::new (base_ + offset) BlockHeader{size_class, offset};
+        return block + 1;
+    }
+
+    // Returns a block to the segment it came from, in whichever process and
+    // at whichever address that segment is mapped here.
+    static void Deallocate(void* ptr)
+    {
+        auto* block = static_cast<BlockHeader*>(ptr) - 1;
+        std::byte* base = reinterpret_cast<std::byte*>(block) - block->offset;
+        Header& head = *reinterpret_cast<Header*>(base);
+        const unsigned int size_class = block->size_class;
+        {
+            SpinGuard guard(head.lock);
+            *reinterpret_cast<std::int64_t*>(ptr) = head.free_lists[size_class];
+            head.free_lists[size_class] = block->offset;
+        }
+        head.in_use.fetch_sub(std::size_t{1} << size_class, std::memory_order_relaxed);
+    }
+
+    // Publishes root as the segment's entry point for other processes. The
+    // segment keeps a reference to it until it is replaced. The slot is typed:
+    // it remembers the type the root was published as, and replacing it or
+    // reading it as another type throws std::logic_error. Clear it with an
+    // empty ShmPtr of the old type before publishing a root of a new one.
+    template <class T>
+    void SetRoot(const ShmPtr<T>& root);
+
+    template <class T>
+    ShmPtr<T> Root();
+
+    static constexpr std::size_t kBlockAlignment = alignof(std::max_align_t);
+
+private:
+    static constexpr std::uint64_t kMagic = 0x53504d454d534547;
+    static constexpr unsigned int kMinClass = 5;
+    static constexpr unsigned int kClasses = 48;
+
+    struct BlockHeader
+    {
+        std::uint32_t size_class;
+        // Distance from the start of the segment; finds the allocator again.
+        std::int64_t offset;
+    };
+    static_assert(sizeof(BlockHeader) == kBlockAlignment);
+
+    struct Header
+    {
+        std::uint64_t magic;
+        std::uint64_t size;
+        std::atomic<std::uint32_t> lock;
+        std::int64_t top;
+        std::int64_t free_lists[kClasses];
+        std::int64_t root;
+        // Tag of the type the root was published as; 0 while there is none.
+        std::uint64_t root_type;
+        std::atomic<std::size_t> in_use;
+    };
+
+    // FNV-1a of the type's name, the same in every process built from the
+    // same sources.
+    template <class T>
+    static std::uint64_t TypeTag()
+    {
+        static const std::uint64_t tag = []
+        {
+            std::uint64_t hash = 0xcbf29ce484222325;
+            for (const char* c = typeid(T).name(); *c != '\0'; ++c)
+            {
+                hash = (hash ^ static_cast<unsigned char>(*c)) * 0x100000001b3;
+            }
+            return hash;
+        }();
+        return tag;
+    }
+
+    class SpinGuard
+    {
+    public:
+        explicit SpinGuard(std::atomic<std::uint32_t>& lock) : lock_(lock)
+        {
+            while (lock_.exchange(1, std::memory_order_acquire) != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        ~SpinGuard()
+        {
+            lock_.store(0, std::memory_order_release);
+        }
+
+    private:
+        std::atomic<std::uint32_t>& lock_;
+    };
+
+    ShmSegment(int fd, std::size_t size) : fd_(fd), size_(size)
+    {
+        void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            const int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "mmap");
+        }
+        base_ = static_cast<std::byte*>(base);
+    }
+
+    static ShmSegment Initialize(int fd, std::size_t size)
+    {
+        if (size < sizeof(Header))
+        {
+            close(fd);
+            throw std::invalid_argument("ShmSegment: size is smaller than the segment header");
+        }
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            const int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "ftruncate");
+        }
+        ShmSegment segment(fd, size);
+        // Fresh pages are zeroed: empty free lists and no root.
+        auto* head = ::new (segment.base_) Header{};
+        head->magic = kMagic;
+        head->size = size;
+        head->top = static_cast<std::int64_t>((sizeof(Header) + kBlockAlignment - 1) / kBlockAlignment * kBlockAlignment);
+        return segment;
+    }
+
+    Header& header() const
+    {
+        return *reinterpret_cast<Header*>(base_);
+    }
+
+    int fd_ = -1;
+    std::byte* base_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+
+//SHARED MEMORY POINTER
+// Intrusive pointer to an object in a ShmSegment. It is itself position
+// independent, so objects in the segment can hold ShmPtrs to each other.
+// There are no converting constructors: the last owner destroys the object
+// through ~T() directly, so T must be the object's complete type.
+template <class T>
+class ShmPtr
+{
+public:
+    ShmPtr() = default;
+
+    explicit ShmPtr(T* ptr) noexcept : ptr_(ptr)
+    {
+        static_assert(std::is_base_of_v<ShmRefCounter, T>, "T must be derived from ShmRefCounter");
+        static_assert(!std::is_polymorphic_v<T>, "Objects in shared memory must not have a vtable");
+        if (ptr)
+        {
+            ptr->ref_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    ShmPtr(const ShmPtr& other) noexcept : ShmPtr(other.get())
+    {
+    }
+
+    ShmPtr(ShmPtr&& other) noexcept : ptr_(other.get())
+    {
+        other.ptr_ = nullptr;
+    }
+
+    ~ShmPtr()
+    {
+        Release(get());
+    }
+
+    ShmPtr& operator=(const ShmPtr& other) noexcept
+    {
+        ShmPtr(other).swap(*this);
+        return *this;
+    }
+
+    ShmPtr& operator=(ShmPtr&& other) noexcept
+    {
+        ShmPtr(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    T* get() const noexcept
+    {
+        return ptr_.get();
+    }
+
+    T* operator->() const noexcept
+    {
+        return get();
+    }
+
+    T& operator*() const noexcept
+    {
+        return *get();
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return static_cast<bool>(ptr_);
+    }
+
+    [[nodiscard]] std::uint32_t use_count() const noexcept
+    {
+        T* ptr = get();
+        return ptr ? ptr->ref_count.load(std::memory_order_relaxed) : 0;
+    }
+
+    void reset() noexcept
+    {
+        ShmPtr().swap(*this);
+    }
+
+    void swap(ShmPtr& other) noexcept
+    {
+        T* mine = get();
+        ptr_ = other.get();
+        other.ptr_ = mine;
+    }
+
+private:
+    static void Release(T* ptr) noexcept
+    {
+        if (ptr && ptr->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            ptr->~T();
+            ShmSegment::Deallocate(ptr);
+        }
+    }
+
+    OffsetPtr<T> ptr_;
+
+    friend class ShmSegment;
+};
+
+template <class T>
+void ShmSegment::SetRoot(const ShmPtr<T>& root)
+{
+    T* next = root.get();
+    assert((next == nullptr || Contains(next)) && "Root must live in this segment");
+    std::int64_t previous = 0;
+    {
+        SpinGuard guard(header().lock);
+        previous = header().root;
+        // The previous root is released as T, so it must have been published as T.
+        if (previous != 0 && header().root_type != TypeTag<T>())
+        {
+            throw std::logic_error("ShmSegment::SetRoot: the root was published as another type");
+        }
+        if (next)
+        {
+            next->ref_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        header().root = next ? reinterpret_cast<std::byte*>(next) - base_ : 0;
+        header().root_type = next ? TypeTag<T>() : 0;
+    }
+    if (previous != 0)
+    {
+        ShmPtr<T>::Release(reinterpret_cast<T*>(base_ + previous));
+    }
+}
+
+template <class T>
+ShmPtr<T> ShmSegment::Root()
+{
+    SpinGuard guard(header().lock);
+    if (header().root == 0)
+    {
+        return ShmPtr<T>();
+    }
+    if (header().root_type != TypeTag<T>())
+    {
+        throw std::logic_error("ShmSegment::Root: the root was published as another type");
+    }
+    return ShmPtr<T>(reinterpret_cast<T*>(base_ + header().root));
+}
+
+// Constructs T in segment and returns its first owner.
+template <class T, class... Args>
+ShmPtr<T> MakeShm(ShmSegment& segment, Args&&... args)
+{
+    static_assert(alignof(T) <= ShmSegment::kBlockAlignment, "ShmSegment blocks are aligned to max_align_t only");
+    void* memory = segment.Allocate(sizeof(T), alignof(T));
+    T* object = nullptr;
+    try
+    {
+        object = ::new (memory) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        ShmSegment::Deallocate(memory);
+        throw;
+    }
+    return ShmPtr<T>(object);
+}
+
+#endif //SHAREDMEMORY_H
@@ -3,21 +3,494 @@
 
 #include <assert.h>
 #include <unordered_map>
+#include <algorithm>
 #include <atomic>
 #include <mutex>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+#include "Census.h"
+#include "ContentionSampler.h"
+#include "Instrumentation.h"
+#include "UniquePointer.h"
+
+template<class Type>
+class SharedPointer;
+
+// Allocators for AllocateShared; keeps the memory_resource* overload distinct.
+template <class Alloc>
+concept SharedAllocator = requires { typename Alloc::value_type; };
 
 template<class Type>
 class WeakPointer;
 
+class ExternalRefCounter;
+
+template <class Type>
+class EnableSharedFromThis;
+
+template <class Type>
+class Borrowed;
+
+template <class Pointer>
+struct OwnershipTransfer;
+
+template <class Type>
+class LocalControlBlock;
+
+
+// Counts of one SharedPointer-managed object. Every SharedPointer and
+// WeakPointer to the object refers to the same block no matter which type or
+// subobject address it was converted to, so conversions never re-key anything.
+class SharedControlBlock
+{
+public:
+    std::atomic<unsigned int> strong = 1;
+    // One per WeakPointer plus one held while strong > 0.
+    std::atomic<unsigned int> weak = 1;
+    // Outstanding Borrowed references; the object must not die while any exist.
+    // Counted in _DEBUG builds only; always present to keep one layout.
+    std::atomic<unsigned int> borrows = 0;
+    // Registry the object was adopted into and the address it is registered
+    // under; null for blocks made by AllocateShared or MakeSharedArray.
+    ExternalRefCounter* registry = nullptr;
+    void* key = nullptr;
+
+    // Increments the strong count unless it already dropped to zero.
+    bool TryAddRef()
+    {
+        unsigned int count = strong.load();
+        while (count != 0)
+        {
+            if (strong.compare_exchange_weak(count, count + 1, std::memory_order_acq_rel))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ReleaseWeak()
+    {
+        if (weak.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            Deallocate();
+        }
+    }
+
+    // Destroys the managed object; called once, after strong reached zero.
+    virtual void Destroy() noexcept = 0;
+    // Frees the block itself; called once, after weak reached zero.
+    virtual void Deallocate() noexcept = 0;
+
+protected:
+    virtual ~SharedControlBlock() = default;
+};
+
+// Block for an object adopted from a raw pointer; Type may be an array type,
+// in which case the default deleter frees the elements with delete[]. A
+// stateless deleter takes no space in the block. The block itself comes from
+// the registry's memory resource.
+template <class Type, class Deleter = std::default_delete<Type>>
+class PointerControlBlock final : public SharedControlBlock
+{
+public:
+    using Element = std::remove_extent_t<Type>;
+
+    static PointerControlBlock* Create(std::pmr::memory_resource* resource, Element* object)
+    {
+        return Create(resource, object, Deleter());
+    }
+
+    // The deleter is only moved from once the block is allocated, so a failed
+    // allocation leaves the caller's deleter as it was.
+    template <class D>
+    static PointerControlBlock* Create(std::pmr::memory_resource* resource, Element* object, D&& deleter)
+    {
+        void* memory = resource->allocate(sizeof(PointerControlBlock), alignof(PointerControlBlock));
+        try
+        {
+            return ::new (memory) PointerControlBlock(resource, object, std::forward<D>(deleter));
+        }
+        catch (...)
+        {
+            resource->deallocate(memory, sizeof(PointerControlBlock), alignof(PointerControlBlock));
+            throw;
+        }
+    }
+
+    void Destroy() noexcept override
+    {
+        SP_INSTRUMENT(Type, Destroyed);
+        if constexpr (!std::is_array_v<Type>)
+        {
+            SP_CENSUS_DESTROYED(Type, object_);
+        }
+        deleter_(object_);
+    }
+
+    void Deallocate() noexcept override
+    {
+        std::pmr::memory_resource* resource = resource_;
+        this->~PointerControlBlock();
+        resource->deallocate(this, sizeof(PointerControlBlock), alignof(PointerControlBlock));
+    }
+
+private:
+    PointerControlBlock(std::pmr::memory_resource* resource, Element* object, Deleter deleter)
+        : resource_(resource), object_(object), deleter_(std::move(deleter))
+    {
+    }
+
+    std::pmr::memory_resource* resource_;
+    Element* object_;
+    [[no_unique_address]] Deleter deleter_;
+};
+
+// Block created by AllocateShared: the counts, the allocator and the object
+// share one allocation obtained from the allocator.
+template <class Type, class Alloc>
+class InplaceControlBlock final : public SharedControlBlock
+{
+public:
+    using Allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<Type>;
 
+    template <class... Args>
+    static InplaceControlBlock* Create(const Alloc& alloc, Args&&... args)
+    {
+        BlockAllocator block_alloc(alloc);
+        InplaceControlBlock* block = std::allocator_traits<BlockAllocator>::allocate(block_alloc, 1);
+        ::new (static_cast<void*>(block)) InplaceControlBlock(alloc);
+        try
+        {
+            std::allocator_traits<Allocator>::construct(block->alloc_, block->object(), std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            block->~InplaceControlBlock();
+            std::allocator_traits<BlockAllocator>::deallocate(block_alloc, block, 1);
+            throw;
+        }
+        return block;
+    }
+
+    Type* object() noexcept
+    {
+        return std::launder(reinterpret_cast<Type*>(storage_));
+    }
+
+    void Destroy() noexcept override
+    {
+        SP_INSTRUMENT(Type, Destroyed);
+        SP_CENSUS_DESTROYED(Type, object());
+        std::allocator_traits<Allocator>::destroy(alloc_, object());
+    }
 
+    void Deallocate() noexcept override
+    {
+        BlockAllocator block_alloc(alloc_);
+        this->~InplaceControlBlock();
+        std::allocator_traits<BlockAllocator>::deallocate(block_alloc, this, 1);
+    }
+
+private:
+    using BlockAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<InplaceControlBlock>;
+
+    explicit InplaceControlBlock(const Alloc& alloc) : alloc_(alloc)
+    {
+    }
+
+    [[no_unique_address]] Allocator alloc_;
+    alignas(Type) std::byte storage_[sizeof(Type)];
+};
+
+// Block created by MakeSharedArray: the counts and the elements share one
+// allocation, with the elements placed right after the block.
+template <class Element>
+class ArrayControlBlock final : public SharedControlBlock
+{
+public:
+    // ValueInit selects Element() over default-initialization; the latter
+    // leaves trivial elements uninitialized and costs nothing per element.
+    template <bool ValueInit>
+    static ArrayControlBlock* Create(std::size_t size)
+    {
+        if (size > (std::numeric_limits<std::size_t>::max() - ElementsOffset()) / sizeof(Element))
+        {
+            throw std::bad_array_new_length();
+        }
+        void* memory = ::operator new(ElementsOffset() + size * sizeof(Element), std::align_val_t{Alignment()});
+        auto* block = ::new (memory) ArrayControlBlock(size);
+        try
+        {
+            if constexpr (ValueInit)
+            {
+                std::uninitialized_value_construct_n(block->elements(), size);
+            }
+            else
+            {
+                std::uninitialized_default_construct_n(block->elements(), size);
+            }
+        }
+        catch (...)
+        {
+            block->~ArrayControlBlock();
+            ::operator delete(memory, std::align_val_t{Alignment()});
+            throw;
+        }
+        SP_INSTRUMENT(Element[], Created);
+        return block;
+    }
+
+    Element* elements() noexcept
+    {
+        return std::launder(reinterpret_cast<Element*>(reinterpret_cast<std::byte*>(this) + ElementsOffset()));
+    }
+
+    void Destroy() noexcept override
+    {
+        SP_INSTRUMENT(Element[], Destroyed);
+        Element* first = elements();
+        for (std::size_t i = size_; i > 0; --i)
+        {
+            std::destroy_at(first + i - 1);
+        }
+    }
+
+    void Deallocate() noexcept override
+    {
+        this->~ArrayControlBlock();
+        ::operator delete(static_cast<void*>(this), std::align_val_t{Alignment()});
+    }
+
+private:
+    explicit ArrayControlBlock(std::size_t size) : size_(size)
+    {
+    }
+
+    static constexpr std::size_t Alignment()
+    {
+        return std::max(alignof(ArrayControlBlock), alignof(Element));
+    }
+
+    static constexpr std::size_t ElementsOffset()
+    {
+        return (sizeof(ArrayControlBlock) + alignof(Element) - 1) / alignof(Element) * alignof(Element);
+    }
+
+    std::size_t size_;
+};
+
+
+// Registry of objects adopted from raw pointers, keyed by the address of the
+// complete object. Only SharedPointer(Type*) and the final release use it;
+// copies, conversions and weak upgrades go through the control block directly.
+//
+// Instance() is the process-wide registry shared by every translation unit. A
+// subsystem can keep its objects apart by passing its own registry to the
+// adopting constructor; that registry must outlive the objects adopted into it.
+//
+// Map nodes, bucket arrays and the control blocks of adopted objects come from
+// a memory resource, by default a pool owned by the registry. Freed nodes and
+// blocks are recycled by the pool, so once a thread has adopted and released
+// a working set, adopting the same number again does not touch the global
+// heap for bookkeeping. Reserve() only pre-sizes the buckets.
 class ExternalRefCounter
 {
 public:
-    std::unordered_map<void*, std::atomic<unsigned int>> ref_map;
+    ExternalRefCounter() = default;
+    ExternalRefCounter(const ExternalRefCounter&) = delete;
+    ExternalRefCounter& operator=(const ExternalRefCounter&) = delete;
+
+    static ExternalRefCounter& Instance()
+    {
+        // Built on first use and never destroyed, so SharedPointers released
+        // during static destruction in any translation unit still find it.
+        static ExternalRefCounter* registry = new ExternalRefCounter();
+        return *registry;
+    }
+
+private:
+    // Declared before ref_map so it outlives the map's nodes.
+    std::pmr::synchronized_pool_resource pool_;
+    std::pmr::memory_resource* resource_ = &pool_;
+
+public:
+    std::pmr::unordered_map<void*, SharedControlBlock*> ref_map{&pool_};
+    std::mutex mutex;
+
+    // Memory resource for registry nodes and new control blocks. It must be
+    // thread-safe if SharedPointers are released on several threads, and it
+    // must outlive every object adopted while it was installed.
+    [[nodiscard]] std::pmr::memory_resource* resource()
+    {
+        std::lock_guard lock(mutex);
+        return resource_;
+    }
+
+    // Moves the registry map onto resource; nullptr restores the built-in
+    // pool. Blocks already allocated are returned to the resource they came from.
+    void SetMemoryResource(std::pmr::memory_resource* resource)
+    {
+        std::lock_guard lock(mutex);
+        resource = resource != nullptr ? resource : &pool_;
+        std::pmr::unordered_map<void*, SharedControlBlock*> map(ref_map.begin(), ref_map.end(),
+                                                                ref_map.bucket_count(), resource);
+        std::destroy_at(&ref_map);
+        std::construct_at(&ref_map, std::move(map));
+        resource_ = resource;
+    }
+
+    // Pre-sizes the bucket array for count objects, so adopting that many
+    // does not rehash. Map nodes and control blocks are still allocated from
+    // the resource as objects are adopted, and recycled once they are freed.
+    void Reserve(std::size_t count)
+    {
+        std::lock_guard lock(mutex);
+        ref_map.reserve(count);
+    }
+
+    // Adds a strong reference to the block registered for key, or registers
+    // the block make_block(resource) creates (which starts with a count of one).
+    template <class Type, class MakeBlock>
+    SharedControlBlock* Adopt(void* key, MakeBlock&& make_block)
+    {
+        std::lock_guard lock(mutex);
+        [[maybe_unused]] const std::size_t buckets = ref_map.bucket_count();
+        auto [it, inserted] = ref_map.try_emplace(key, nullptr);
+        SP_INSTRUMENT(Type, MapLookup);
+        SP_INSTRUMENT_IF(ref_map.bucket_count() != buckets, Type, MapRehash);
+        SP_INSTRUMENT_IF(ref_map.bucket_size(ref_map.bucket(key)) > 1, Type, MapCollision);
+
+        // A registered block whose count already reached zero belongs to an
+        // object that is being destroyed; the new owner gets a fresh block.
+        if (!inserted && it->second->TryAddRef())
+        {
+            return it->second;
+        }
+        SharedControlBlock* block = nullptr;
+        try
+        {
+            block = make_block(resource_);
+        }
+        catch (...)
+        {
+            if (inserted)
+            {
+                ref_map.erase(it);
+            }
+            throw;
+        }
+        block->registry = this;
+        block->key = key;
+        it->second = block;
+        return block;
+    }
+
+    // Adds a strong reference to the block registered for key, if there is one
+    // and its object is still alive.
+    template <class Type>
+    SharedControlBlock* Find(void* key)
+    {
+        std::lock_guard lock(mutex);
+        SP_INSTRUMENT(Type, MapLookup);
+        auto it = ref_map.find(key);
+        if (it == ref_map.end() || !it->second->TryAddRef())
+        {
+            return nullptr;
+        }
+        return it->second;
+    }
+
+    // Unregisters a block whose strong count reached zero.
+    template <class Type>
+    void Forget(SharedControlBlock* block)
+    {
+        std::lock_guard lock(mutex);
+        SP_INSTRUMENT(Type, MapLookup);
+        auto it = ref_map.find(block->key);
+        if (it != ref_map.end() && it->second == block)
+        {
+            ref_map.erase(it);
+        }
+    }
+
+    // Number of objects currently owned by SharedPointers. Per-type counts,
+    // sizes and creation stacks are available from Census when it is enabled.
+    [[nodiscard]] std::size_t LiveObjects()
+    {
+        std::lock_guard lock(mutex);
+        return ref_map.size();
+    }
 };
 
-static ExternalRefCounter ref_counter;
+// Address of the complete object, so a Base* and a Derived* to the same
+// object are registered under the same key.
+template <class Type>
+void* RegistryKey(Type* ptr)
+{
+    if constexpr (std::is_polymorphic_v<Type>)
+    {
+        return const_cast<void*>(dynamic_cast<const volatile void*>(ptr));
+    }
+    else
+    {
+        return const_cast<void*>(static_cast<const volatile void*>(ptr));
+    }
+}
+
+// Points the object's EnableSharedFromThis base, if it has one, at the block
+// that now owns it. Runs before the block is published to other threads.
+template <class Object>
+void BindWeakThis(Object* ptr, SharedControlBlock* control) noexcept
+{
+    if constexpr (requires { typename Object::SharedFromThisType; })
+    {
+        using Base = typename Object::SharedFromThisType;
+        EnableSharedFromThis<Base>::Bind(static_cast<Base*>(ptr), control);
+    }
+}
+
+template <class Type>
+void SharedAddRef(SharedControlBlock* control) noexcept
+{
+    SP_CONTENTION_BEGIN(timing, typeid(Type).name());
+    control->strong.fetch_add(1, std::memory_order_relaxed);
+    SP_CONTENTION_END(timing, control, AddRef);
+    SP_INSTRUMENT(Type, AddRef);
+}
+
+template <class Type>
+void SharedRelease(SharedControlBlock* control) noexcept
+{
+    SP_CONTENTION_BEGIN(timing, typeid(Type).name());
+    const unsigned int previous = control->strong.fetch_sub(1, std::memory_order_acq_rel);
+    SP_CONTENTION_END(timing, control, Release);
+    SP_INSTRUMENT(Type, Release);
+    if (previous == 1)
+    {
+#ifdef _DEBUG
+        assert(control->borrows.load() == 0 && "Object destroyed while borrowed");
+#endif
+        // Blocks made by AllocateShared or MakeSharedArray were never registered.
+        if (control->registry != nullptr)
+        {
+            control->registry->Forget<Type>(control);
+        }
+        control->Destroy();
+        control->ReleaseWeak();
+    }
+}
+
 
 //SHARED POINTER
 template <class Type>
@@ -27,134 +500,438 @@ public:
     constexpr SharedPointer() noexcept = default;
 
 
-    explicit SharedPointer(Type* ptr)
+    explicit SharedPointer(Type* ptr, ExternalRefCounter& registry = ExternalRefCounter::Instance())
     {
         assert(ptr && "In constructor shared pointer received nullptr");
-        auto it = ref_counter.ref_map.find(ptr);
+        bool created = false;
+        try
+        {
+            control_ = registry.Adopt<Type>(RegistryKey(ptr), [ptr, &created](std::pmr::memory_resource* resource)
+            {
+                created = true;
+                auto* block = PointerControlBlock<Type>::Create(resource, ptr);
+                BindWeakThis(ptr, block);
+                return block;
+            });
+        }
+        catch (...)
+        {
+            // Adopt only throws while registering a new object, so ptr has no other owner.
+            delete ptr;
+            throw;
+        }
+        pointer_ = ptr;
+        SP_INSTRUMENT(Type, AddRef);
+        if (created)
+        {
+            SP_INSTRUMENT(Type, Created);
+            SP_CENSUS_CREATED(Type, ptr);
+        }
+    }
 
-        if (it != ref_counter.ref_map.end())
+    // Adopts ptr, which deleter frees after the last owner is gone. If ptr is
+    // already owned by SharedPointers, their deleter is kept and this one dropped.
+    template <class Deleter>
+        requires std::invocable<Deleter&, Type*>
+    SharedPointer(Type* ptr, Deleter deleter, ExternalRefCounter& registry = ExternalRefCounter::Instance())
+    {
+        assert(ptr && "In constructor shared pointer received nullptr");
+        bool created = false;
+        try
         {
-            ref_counter.ref_map[ptr].fetch_add(1, std::memory_order_acq_rel);
+            control_ = registry.Adopt<Type>(RegistryKey(ptr), [ptr, &deleter, &created](std::pmr::memory_resource* resource)
+            {
+                created = true;
+                auto* block = PointerControlBlock<Type, Deleter>::Create(resource, ptr, std::move(deleter));
+                BindWeakThis(ptr, block);
+                return block;
+            });
         }
-        else
+        catch (...)
         {
-            ref_counter.ref_map[ptr].store(1);
+            // Create moves the deleter only once the block is allocated, so it
+            // is still usable if registering ptr failed.
+            deleter(ptr);
+            throw;
         }
         pointer_ = ptr;
+        SP_INSTRUMENT(Type, AddRef);
+        if (created)
+        {
+            SP_INSTRUMENT(Type, Created);
+            SP_CENSUS_CREATED(Type, ptr);
+        }
     }
 
-    SharedPointer(const SharedPointer& other)
+    // Takes the object over from a unique owner. The one control block is
+    // allocated here, from the registry's pool; the object is not registered,
+    // since nothing else can own it yet.
+    template <class Other, class Deleter>
+        requires std::convertible_to<Other*, Type*>
+    SharedPointer(UniquePointer<Other, Deleter>&& unique)
     {
-        assert(other.pointer_ && "In constructor shared pointer received nullptr");
-        pointer_ = other.pointer_;
-        ref_counter.ref_map[pointer_].fetch_add(1);
+        if (!unique)
+        {
+            return;
+        }
+        control_ = PointerControlBlock<Other, Deleter>::Create(ExternalRefCounter::Instance().resource(),
+                                                              unique.get(), std::move(unique.get_deleter()));
+        Other* ptr = unique.release();
+        BindWeakThis(ptr, control_);
+        pointer_ = ptr;
+        SP_INSTRUMENT(Other, Created);
+        SP_INSTRUMENT(Type, AddRef);
+        SP_CENSUS_CREATED(Other, ptr);
+    }
+
+    SharedPointer(const SharedPointer& other) noexcept
+    {
+        Acquire(other.pointer_, other.control_);
     }
 
     SharedPointer(SharedPointer&& other) noexcept
     {
-        assert(other.pointer_ && "In constructor shared pointer received nullptr");
         pointer_ = other.pointer_;
+        control_ = other.control_;
         other.pointer_ = nullptr;
+        other.control_ = nullptr;
     }
 
-    virtual ~SharedPointer()
+    // Upcast: shares the count of other; only the stored address is adjusted.
+    template <class Other>
+        requires std::convertible_to<Other*, Type*>
+    SharedPointer(const SharedPointer<Other>& other) noexcept
     {
-        if (ref_counter.ref_map[pointer_].load() == 1)
-        {
-            ref_counter.ref_map.erase(pointer_);
-            delete pointer_;
-            pointer_ = nullptr;
-        }
-        else
+        Acquire(other.pointer_, other.control_);
+    }
+
+    template <class Other>
+        requires std::convertible_to<Other*, Type*>
+    SharedPointer(SharedPointer<Other>&& other) noexcept
+    {
+        pointer_ = other.pointer_;
+        control_ = other.control_;
+        other.pointer_ = nullptr;
+        other.control_ = nullptr;
+    }
+
+    // Aliasing: shares ownership of owner's object but points at ptr,
+    // typically a member or subobject of it.
+    template <class Other>
+    SharedPointer(const SharedPointer<Other>& owner, Type* ptr) noexcept
+    {
+        Acquire(ptr, owner.control_);
+    }
+
+    template <class Other>
+    SharedPointer(SharedPointer<Other>&& owner, Type* ptr) noexcept
+    {
+        if (owner.control_ == nullptr)
         {
-            ref_counter.ref_map[pointer_].fetch_sub(1);
+            return;
         }
+        pointer_ = ptr;
+        control_ = owner.control_;
+        owner.pointer_ = nullptr;
+        owner.control_ = nullptr;
     }
 
-    SharedPointer& operator=(const SharedPointer& other)
+    virtual ~SharedPointer()
     {
-        assert(other.pointer_ && "In operator= shared pointer received nullptr");
+        Release();
+    }
 
+    SharedPointer& operator=(const SharedPointer& other) noexcept
+    {
         if (this == &other)
         {
-            assert(this != &other && "In operator= shared pointer received the same pointer");
             return *this;
         }
+        SharedPointer(other).swap(*this);
+        return *this;
+    }
 
-        if (pointer_ == other.pointer_)
+    SharedPointer& operator=(SharedPointer&& other) noexcept
+    {
+        if (this == &other)
         {
-            assert(pointer_ != other.pointer_ && "In operator= shared pointer received the same pointer");
             return *this;
         }
+        SharedPointer(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    template <class Other>
+        requires std::convertible_to<Other*, Type*>
+    SharedPointer& operator=(const SharedPointer<Other>& other) noexcept
+    {
+        SharedPointer(other).swap(*this);
+        return *this;
+    }
 
-        if (pointer_ == nullptr)
+    Type* operator->() const
+    {
+        return pointer_;
+    }
+
+    Type& operator*() const
+    {
+        return *pointer_;
+    }
+
+    explicit operator bool() const
+    {
+        return pointer_ != nullptr;
+    }
+
+    bool operator==(const SharedPointer& other) const
+    {
+        return pointer_ == other.pointer_;
+    }
+
+    bool operator!=(const SharedPointer& other) const
+    {
+        return pointer_ != other.pointer_;
+    }
+
+    Type* get() const
+    {
+        return pointer_;
+    }
+
+    [[nodiscard]] bool unique() const
+    {
+        return use_count() == 1;
+    }
+
+    [[nodiscard]] std::size_t use_count() const
+    {
+        return control_ ? control_->strong.load(std::memory_order_acquire) : 0;
+    }
+
+    void reset()
+    {
+        Release();
+    }
+
+    void swap(SharedPointer& other) noexcept
+    {
+        std::swap(pointer_, other.pointer_);
+        std::swap(control_, other.control_);
+    }
+
+private:
+    struct AdoptTag
+    {
+    };
+
+    // Takes over a strong reference that the caller already added to control.
+    SharedPointer(Type* ptr, SharedControlBlock* control, AdoptTag) noexcept
+        : pointer_(ptr), control_(control)
+    {
+    }
+
+    void Acquire(Type* ptr, SharedControlBlock* control) noexcept
+    {
+        if (control == nullptr)
         {
-            pointer_ = other.pointer_;
-            ref_counter.ref_map[pointer_].fetch_add(1);
+            return;
         }
-        else
+        SharedAddRef<Type>(control);
+        pointer_ = ptr;
+        control_ = control;
+    }
+
+    void Release() noexcept
+    {
+        if (control_ == nullptr)
         {
-            ref_counter.ref_map[pointer_].fetch_sub(1);
-            pointer_ = other.pointer_;
-            ref_counter.ref_map[pointer_].fetch_add(1);
+            pointer_ = nullptr;
+            return;
         }
-        return *this;
-
+        SharedControlBlock* control = control_;
+        pointer_ = nullptr;
+        control_ = nullptr;
+        SharedRelease<Type>(control);
     }
 
-    SharedPointer& operator=(SharedPointer&& other) noexcept
+    Type* pointer_ = nullptr;
+    SharedControlBlock* control_ = nullptr;
+
+    template <class Other>
+    friend class SharedPointer;
+
+    template <class Other>
+    friend class WeakPointer;
+
+    template <class Other>
+    friend class Borrowed;
+
+    template <class To, class From>
+    friend SharedPointer<To> StaticPointerCast(const SharedPointer<From>& from) noexcept;
+
+    template <class To, class From>
+    friend SharedPointer<To> DynamicPointerCast(const SharedPointer<From>& from) noexcept;
+
+    template <class To, class From>
+    friend SharedPointer<To> ConstPointerCast(const SharedPointer<From>& from) noexcept;
+
+    template <class T, SharedAllocator Alloc, class... Args>
+    friend SharedPointer<T> AllocateShared(const Alloc& alloc, Args&&... args);
+
+    template <class Pointer>
+    friend struct OwnershipTransfer;
+
+    friend class LocalControlBlock<Type>;
+};
+
+
+// Constructs a Type with memory for both the object and its counts taken from
+// alloc in a single allocation. The object is not registered for adoption, so
+// it must not be passed to SharedPointer(Type*) again.
+template <class T, SharedAllocator Alloc, class... Args>
+SharedPointer<T> AllocateShared(const Alloc& alloc, Args&&... args)
+{
+    auto* block = InplaceControlBlock<T, Alloc>::Create(alloc, std::forward<Args>(args)...);
+    BindWeakThis(block->object(), block);
+    SP_INSTRUMENT(T, Created);
+    SP_INSTRUMENT(T, AddRef);
+    SP_CENSUS_CREATED(T, block->object());
+    return SharedPointer<T>(block->object(), block, typename SharedPointer<T>::AdoptTag{});
+}
+
+template <class T, class... Args>
+SharedPointer<T> AllocateShared(std::pmr::memory_resource* resource, Args&&... args)
+{
+    return AllocateShared<T>(std::pmr::polymorphic_allocator<T>(resource), std::forward<Args>(args)...);
+}
+
+
+template <class To, class From>
+SharedPointer<To> StaticPointerCast(const SharedPointer<From>& from) noexcept
+{
+    return SharedPointer<To>(from, static_cast<To*>(from.pointer_));
+}
+
+// Empty if the object is not a To; otherwise shares from's count.
+template <class To, class From>
+SharedPointer<To> DynamicPointerCast(const SharedPointer<From>& from) noexcept
+{
+    if (To* ptr = dynamic_cast<To*>(from.pointer_))
     {
-        assert(other.pointer_ && "In operator= shared pointer received nullptr");
+        return SharedPointer<To>(from, ptr);
+    }
+    return SharedPointer<To>();
+}
 
-        if (this == &other)
+template <class To, class From>
+SharedPointer<To> ConstPointerCast(const SharedPointer<From>& from) noexcept
+{
+    return SharedPointer<To>(from, const_cast<To*>(from.pointer_));
+}
+
+
+//SHARED ARRAY POINTER
+// Owns an array and knows its length. Created by MakeSharedArray, which puts
+// the counts and the elements in one allocation, or adopted from new[].
+template <class Type>
+class SharedPointer<Type[]>
+{
+public:
+    constexpr SharedPointer() noexcept = default;
+
+    SharedPointer(Type* ptr, std::size_t size, ExternalRefCounter& registry = ExternalRefCounter::Instance())
+    {
+        assert(ptr && "In constructor shared pointer received nullptr");
+        try
         {
-            return *this;
+            control_ = registry.Adopt<Type[]>(RegistryKey(ptr), [ptr](std::pmr::memory_resource* resource)
+            {
+                SP_INSTRUMENT(Type[], Created);
+                return PointerControlBlock<Type[]>::Create(resource, ptr);
+            });
         }
-
-        if(pointer_ == other.pointer_)
+        catch (...)
         {
-            other.pointer_ = nullptr;
-            return *this;
+            delete[] ptr;
+            throw;
         }
+        pointer_ = ptr;
+        size_ = size;
+        SP_INSTRUMENT(Type[], AddRef);
+    }
 
-        if(pointer_ == nullptr)
+    // Takes an array over from a unique owner, which does not know the
+    // length; size is the caller's. Like the single-object conversion, the
+    // array is not registered.
+    template <class Deleter>
+    SharedPointer(UniquePointer<Type[], Deleter>&& unique, std::size_t size)
+    {
+        if (!unique)
         {
-            pointer_ = other.pointer_;
-            other.pointer_ = nullptr;
+            return;
         }
-        else
+        control_ = PointerControlBlock<Type[], Deleter>::Create(ExternalRefCounter::Instance().resource(),
+                                                               unique.get(), std::move(unique.get_deleter()));
+        pointer_ = unique.release();
+        size_ = size;
+        SP_INSTRUMENT(Type[], Created);
+        SP_INSTRUMENT(Type[], AddRef);
+    }
+
+    SharedPointer(const SharedPointer& other) noexcept
+    {
+        if (other.control_ == nullptr)
         {
-            if(ref_counter.ref_map[pointer_].fetch_sub(1) == 1)
-            {
-                ref_counter.ref_map.erase(pointer_);
-                delete pointer_;
-            }
-            pointer_ = other.pointer_;
-            other.pointer_ = nullptr;
+            return;
         }
-        return *this;
+        SharedAddRef<Type[]>(other.control_);
+        pointer_ = other.pointer_;
+        control_ = other.control_;
+        size_ = other.size_;
     }
 
-    Type* operator->() const
+    SharedPointer(SharedPointer&& other) noexcept
     {
-        return pointer_;
+        swap(other);
     }
 
-    Type& operator*() const
+    ~SharedPointer()
     {
-        return *pointer_;
+        reset();
     }
 
-    explicit operator bool() const
+    SharedPointer& operator=(const SharedPointer& other) noexcept
     {
-        return pointer_ != nullptr;
+        if (this == &other)
+        {
+            return *this;
+        }
+        SharedPointer(other).swap(*this);
+        return *this;
     }
 
-    Type operator[](int index) const
+    SharedPointer& operator=(SharedPointer&& other) noexcept
     {
+        if (this == &other)
+        {
+            return *this;
+        }
+        SharedPointer(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    Type& operator[](std::size_t index) const
+    {
+        assert(index < size_ && "Shared array index out of range");
         return pointer_[index];
     }
 
+    explicit operator bool() const
+    {
+        return pointer_ != nullptr;
+    }
+
     bool operator==(const SharedPointer& other) const
     {
         return pointer_ == other.pointer_;
@@ -170,52 +947,112 @@ public:
         return pointer_;
     }
 
+    [[nodiscard]] std::size_t size() const
+    {
+        return size_;
+    }
+
+    [[nodiscard]] std::span<Type> span() const
+    {
+        return std::span<Type>(pointer_, size_);
+    }
+
     [[nodiscard]] bool unique() const
     {
-        return ref_counter.ref_map[pointer_].load() == 1;
+        return use_count() == 1;
     }
 
     [[nodiscard]] std::size_t use_count() const
     {
-        return ref_counter.ref_map[pointer_].load();
+        return control_ ? control_->strong.load(std::memory_order_acquire) : 0;
     }
 
     void reset()
     {
-        if (pointer_ != nullptr && ref_counter.ref_map[pointer_].load() == 1)
-        {
-            delete pointer_;
-            ref_counter.ref_map.erase(pointer_);
-            pointer_ = nullptr;
-        }
-        else
+        if (control_ == nullptr)
         {
-            ref_counter.ref_map[pointer_].fetch_sub(1);
-            pointer_ = nullptr;
+            return;
         }
+        SharedControlBlock* control = control_;
+        pointer_ = nullptr;
+        control_ = nullptr;
+        size_ = 0;
+        SharedRelease<Type[]>(control);
+    }
+
+    void swap(SharedPointer& other) noexcept
+    {
+        std::swap(pointer_, other.pointer_);
+        std::swap(control_, other.control_);
+        std::swap(size_, other.size_);
     }
 
 private:
+    SharedPointer(ArrayControlBlock<Type>* control, std::size_t size) noexcept
+        : pointer_(control->elements()), control_(control), size_(size)
+    {
+    }
+
     Type* pointer_ = nullptr;
+    SharedControlBlock* control_ = nullptr;
+    std::size_t size_ = 0;
 
-    friend class WeakPointer<Type>;
+    template <class T>
+    friend SharedPointer<T[]> MakeSharedArray(std::size_t size);
+
+    template <class T>
+    friend SharedPointer<T[]> MakeSharedArrayForOverwrite(std::size_t size);
 };
 
+// Value-initialized array of size elements in a single allocation.
+template <class T>
+SharedPointer<T[]> MakeSharedArray(std::size_t size)
+{
+    return SharedPointer<T[]>(ArrayControlBlock<T>::template Create<true>(size), size);
+}
+
+// Like MakeSharedArray but default-initializes the elements, so numeric
+// buffers are left uninitialized instead of being zeroed.
+template <class T>
+SharedPointer<T[]> MakeSharedArrayForOverwrite(std::size_t size)
+{
+    return SharedPointer<T[]>(ArrayControlBlock<T>::template Create<false>(size), size);
+}
+
 
 //WEAK POINTER
 template <class Type>
 class WeakPointer
 {
  friend class SharedPointer<Type>;
+ friend class EnableSharedFromThis<Type>;
 public:
     constexpr WeakPointer() = default;
 
-    explicit WeakPointer(const SharedPointer<Type>& shared_ptr) noexcept
+    template <class Other>
+        requires std::convertible_to<Other*, Type*>
+    explicit WeakPointer(const SharedPointer<Other>& shared_ptr) noexcept
+    {
+        Acquire(shared_ptr.pointer_, shared_ptr.control_);
+    }
+
+    WeakPointer(const WeakPointer& other) noexcept
     {
-        pointer_ = shared_ptr.pointer_;
+        Acquire(other.pointer_, other.control_);
     }
 
-    ~WeakPointer() = default;
+    WeakPointer(WeakPointer&& other) noexcept
+    {
+        swap(other);
+    }
+
+    ~WeakPointer()
+    {
+        if (control_)
+        {
+            control_->ReleaseWeak();
+        }
+    }
 
     WeakPointer& operator=(const WeakPointer& shared_ptr)
     {
@@ -223,7 +1060,17 @@ public:
         {
             return *this;
         }
-        pointer_ = shared_ptr.pointer_;
+        WeakPointer(shared_ptr).swap(*this);
+        return *this;
+    }
+
+    WeakPointer& operator=(WeakPointer&& other) noexcept
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        WeakPointer(std::move(other)).swap(*this);
         return *this;
     }
 
@@ -244,21 +1091,119 @@ public:
 
     [[nodiscard]] bool expired() const
     {
-        return ref_counter.ref_map.find(pointer_) == ref_counter.ref_map.end();
+        return use_count() == 0;
     }
 
     [[nodiscard]] std::size_t use_count() const
     {
-        return ref_counter.ref_map[pointer_].load();
+        return control_ ? control_->strong.load(std::memory_order_acquire) : 0;
     }
 
     SharedPointer<Type> lock() const
     {
-        return SharedPointer<Type>(pointer_);
+        // The count is raised with a CAS that fails once it reached zero, so an
+        // object that is already being destroyed is never handed out again.
+        if (control_ == nullptr || !control_->TryAddRef())
+        {
+            SP_INSTRUMENT(Type, WeakLockMiss);
+            return SharedPointer<Type>();
+        }
+        SP_INSTRUMENT(Type, WeakLockHit);
+        SP_INSTRUMENT(Type, AddRef);
+        return SharedPointer<Type>(pointer_, control_, typename SharedPointer<Type>::AdoptTag{});
+    }
+
+    void reset()
+    {
+        WeakPointer().swap(*this);
+    }
+
+    void swap(WeakPointer& other) noexcept
+    {
+        std::swap(pointer_, other.pointer_);
+        std::swap(control_, other.control_);
     }
 
 private:
+    void Acquire(Type* ptr, SharedControlBlock* control) noexcept
+    {
+        if (control == nullptr)
+        {
+            return;
+        }
+        control->weak.fetch_add(1, std::memory_order_relaxed);
+        pointer_ = ptr;
+        control_ = control;
+    }
+
     Type* pointer_ = nullptr;
+    SharedControlBlock* control_ = nullptr;
+};
+
+
+// Base for objects that need to hand out SharedPointers to themselves.
+// Whichever SharedPointer first takes ownership of the object stores a weak
+// reference to its control block here, so SharedFromThis() is one CAS on the
+// count: no registry lookup, and safe to call from several threads at once.
+template <class Type>
+class EnableSharedFromThis
+{
+public:
+    using SharedFromThisType = Type;
+
+    // Must only be called while a SharedPointer owns the object.
+    SharedPointer<Type> SharedFromThis()
+    {
+        SharedPointer<Type> self = weak_this_.lock();
+        assert(self && "SharedFromThis called on an object no SharedPointer owns");
+        return self;
+    }
+
+    SharedPointer<const Type> SharedFromThis() const
+    {
+        SharedPointer<const Type> self(weak_this_.lock());
+        assert(self && "SharedFromThis called on an object no SharedPointer owns");
+        return self;
+    }
+
+    // Empty if no SharedPointer has owned the object yet.
+    WeakPointer<Type> WeakFromThis() noexcept
+    {
+        return weak_this_;
+    }
+
+protected:
+    EnableSharedFromThis() noexcept = default;
+
+    // A copy is a different object: it starts without an owner.
+    EnableSharedFromThis(const EnableSharedFromThis&) noexcept
+    {
+    }
+
+    EnableSharedFromThis& operator=(const EnableSharedFromThis&) noexcept
+    {
+        return *this;
+    }
+
+    ~EnableSharedFromThis() = default;
+
+private:
+    static void Bind(Type* self, SharedControlBlock* control) noexcept
+    {
+        WeakPointer<Type>& weak_this = static_cast<EnableSharedFromThis*>(self)->weak_this_;
+        // Keep the first owner if the object is somehow adopted twice.
+        if (!weak_this.expired())
+        {
+            return;
+        }
+        weak_this.reset();
+        weak_this.Acquire(self, control);
+    }
+
+    mutable WeakPointer<Type> weak_this_;
+
+    template <class Object>
+    friend void BindWeakThis(Object* ptr, SharedControlBlock* control) noexcept;
 };
 
 
@@ -0,0 +1,216 @@
+#ifndef UNIQUEPOINTER_H
+#define UNIQUEPOINTER_H
+
+#include <assert.h>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Single owner. With a stateless deleter it is exactly one pointer wide; a
+// SharedPointer or IntrusivePtr can take the object over by moving from it.
+
+template <class Type, class Deleter = std::default_delete<Type>>
+class UniquePointer
+{
+public:
+    constexpr UniquePointer() noexcept = default;
+
+    explicit UniquePointer(Type* ptr, Deleter deleter = Deleter()) noexcept
+        : pointer_(ptr), deleter_(std::move(deleter))
+    {
+    }
+
+    UniquePointer(const UniquePointer&) = delete;
+    UniquePointer& operator=(const UniquePointer&) = delete;
+
+    UniquePointer(UniquePointer&& other) noexcept
+        : pointer_(other.release()), deleter_(std::move(other.deleter_))
+    {
+    }
+
+    template <class Other, class OtherDeleter>
+        requires std::convertible_to<Other*, Type*> && std::constructible_from<Deleter, OtherDeleter&&>
+    UniquePointer(UniquePointer<Other, OtherDeleter>&& other) noexcept
+        : pointer_(other.release()), deleter_(std::move(other.get_deleter()))
+    {
+    }
+
+    ~UniquePointer()
+    {
+        if (pointer_)
+        {
+            deleter_(pointer_);
+        }
+    }
+
+    UniquePointer& operator=(UniquePointer&& other) noexcept
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        reset(other.release());
+        deleter_ = std::move(other.deleter_);
+        return *this;
+    }
+
+    Type* operator->() const noexcept
+    {
+        return pointer_;
+    }
+
+    Type& operator*() const
+    {
+        return *pointer_;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return pointer_ != nullptr;
+    }
+
+    Type* get() const noexcept
+    {
+        return pointer_;
+    }
+
+    Deleter& get_deleter() noexcept
+    {
+        return deleter_;
+    }
+
+    // Gives up ownership without destroying the object.
+    [[nodiscard]] Type* release() noexcept
+    {
+        Type* ptr = pointer_;
+        pointer_ = nullptr;
+        return ptr;
+    }
+
+    void reset(Type* ptr = nullptr) noexcept
+    {
+        Type* old = pointer_;
+        pointer_ = ptr;
+        if (old)
+        {
+            deleter_(old);
+        }
+    }
+
+    void swap(UniquePointer& other) noexcept
+    {
+        std::swap(pointer_, other.pointer_);
+        std::swap(deleter_, other.deleter_);
+    }
+
+private:
+    Type* pointer_ = nullptr;
+    [[no_unique_address]] Deleter deleter_;
+};
+
+
+//UNIQUE ARRAY POINTER
+template <class Type, class Deleter>
+class UniquePointer<Type[], Deleter>
+{
+public:
+    constexpr UniquePointer() noexcept = default;
+
+    explicit UniquePointer(Type* ptr, Deleter deleter = Deleter()) noexcept
+        : pointer_(ptr), deleter_(std::move(deleter))
+    {
+    }
+
+    UniquePointer(const UniquePointer&) = delete;
+    UniquePointer& operator=(const UniquePointer&) = delete;
+
+    UniquePointer(UniquePointer&& other) noexcept
+        : pointer_(other.release()), deleter_(std::move(other.deleter_))
+    {
+    }
+
+    ~UniquePointer()
+    {
+        if (pointer_)
+        {
+            deleter_(pointer_);
+        }
+    }
+
+    UniquePointer& operator=(UniquePointer&& other) noexcept
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        reset(other.release());
+        deleter_ = std::move(other.deleter_);
+        return *this;
+    }
+
+    Type& operator[](std::size_t index) const
+    {
+        return pointer_[index];
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return pointer_ != nullptr;
+    }
+
+    Type* get() const noexcept
+    {
+        return pointer_;
+    }
+
+    Deleter& get_deleter() noexcept
+    {
+        return deleter_;
+    }
+
+    [[nodiscard]] Type* release() noexcept
+    {
+        Type* ptr = pointer_;
+        pointer_ = nullptr;
+        return ptr;
+    }
+
+    void reset(Type* ptr = nullptr) noexcept
+    {
+        Type* old = pointer_;
+        pointer_ = ptr;
+        if (old)
+        {
+            deleter_(old);
+        }
+    }
+
+    void swap(UniquePointer& other) noexcept
+    {
+        std::swap(pointer_, other.pointer_);
+        std::swap(deleter_, other.deleter_);
+    }
+
+private:
+    Type* pointer_ = nullptr;
+    [[no_unique_address]] Deleter deleter_;
+};
+
+
+template <class T, class... Args>
+    requires (!std::is_array_v<T>)
+UniquePointer<T> MakeUnique(Args&&... args)
+{
+    return UniquePointer<T>(new T(std::forward<Args>(args)...));
+}
+
+// Value-initialized array of size elements.
+template <class T>
+UniquePointer<T[]> MakeUniqueArray(std::size_t size)
+{
+    return UniquePointer<T[]>(new T[size]());
+}
+
+#endif //UNIQUEPOINTER_H
@@ -0,0 +1,207 @@
+#ifndef WEAKVALUECACHE_H
+#define WEAKVALUECACHE_H
+
+#include <assert.h>
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "SharedPointer.h"
+#include "UniquePointer.h"
+
+// "Load once, share while in use" cache. Values are held through WeakPointer,
+// so the cache never keeps anything alive: Get() returns the value while some
+// caller still owns it and loads it again afterwards.
+//
+// A hit takes a shard's shared lock and upgrades the weak pointer with the
+// control block's CAS, so concurrent hits on one shard do not serialize.
+// Concurrent misses for one key are coalesced: the first caller runs the
+// loader and the others wait on its shared_future.
+//
+// Values are owned through a deleter that erases their entry when the last
+// SharedPointer goes away, so no eviction pass is needed. The cache must
+// outlive every value it has handed out.
+//
+// Values are SharedPointer-owned rather than RefCounter objects held through
+// IntrusiveWeakPtr. Both upgrade with a CAS on the count, but an intrusive
+// object frees itself through RefCounter::Destroy, which gives the cache no
+// per-value hook to drop its entry at the last release.
+
+template <class Key, class Value, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>>
+class WeakValueCache
+{
+public:
+    using Loader = std::function<UniquePointer<Value>(const Key&)>;
+
+    explicit WeakValueCache(Loader loader) : loader_(std::move(loader))
+    {
+    }
+
+    WeakValueCache(const WeakValueCache&) = delete;
+    WeakValueCache& operator=(const WeakValueCache&) = delete;
+
+    ~WeakValueCache()
+    {
+        assert(size() == 0 && "WeakValueCache destroyed while its values are alive");
+    }
+
+    // Returns the cached value, loading it if no live one exists. Empty if the
+    // loader returned null; rethrows the loader's exception to every waiter.
+    SharedPointer<Value> Get(const Key& key)
+    {
+        Shard& shard = ShardFor(key);
+        {
+            std::shared_lock read(shard.mutex);
+            if (SharedPointer<Value> hit = Lookup(shard, key))
+            {
+                return hit;
+            }
+        }
+
+        std::promise<SharedPointer<Value>> promise;
+        std::shared_future<SharedPointer<Value>> pending;
+        {
+            std::unique_lock write(shard.mutex);
+            if (SharedPointer<Value> hit = Lookup(shard, key))
+            {
+                return hit;
+            }
+            auto [load, first] = shard.loads.try_emplace(key);
+            if (first)
+            {
+                load->second = promise.get_future().share();
+            }
+            else
+            {
+                pending = load->second;
+            }
+        }
+        if (pending.valid())
+        {
+            return pending.get();
+        }
+        return Load(shard, key, promise);
+    }
+
+    // Returns the cached value if it is alive, without loading.
+    SharedPointer<Value> Find(const Key& key)
+    {
+        Shard& shard = ShardFor(key);
+        std::shared_lock read(shard.mutex);
+        return Lookup(shard, key);
+    }
+
+    // Number of live values.
+    [[nodiscard]] std::size_t size() const
+    {
+        std::size_t total = 0;
+        for (const Shard& shard : shards_)
+        {
+            std::shared_lock read(shard.mutex);
+            total += shard.entries.size();
+        }
+        return total;
+    }
+
+private:
+    static constexpr std::size_t kShards = 64;
+
+    struct Entry
+    {
+        WeakPointer<Value> weak;
+        // Identifies the value the entry was made for, so a dying value does
+        // not erase the entry of its reloaded replacement.
+        const Value* object;
+    };
+
+    struct Shard
+    {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<Key, Entry, Hash, KeyEqual> entries;
+        std::unordered_map<Key, std::shared_future<SharedPointer<Value>>, Hash, KeyEqual> loads;
+    };
+
+    // Deleter of cached values: unlinks the entry, then frees the value.
+    struct Evictor
+    {
+        WeakValueCache* cache;
+        Key key;
+
+        void operator()(Value* value) const
+        {
+            cache->Evict(key, value);
+            delete value;
+        }
+    };
+
+    Shard& ShardFor(const Key& key)
+    {
+        return shards_[Hash{}(key) % kShards];
+    }
+
+    // Requires the shard's lock.
+    static SharedPointer<Value> Lookup(Shard& shard, const Key& key)
+    {
+        auto it = shard.entries.find(key);
+        if (it == shard.entries.end())
+        {
+            return SharedPointer<Value>();
+        }
+        return it->second.weak.lock();
+    }
+
+    SharedPointer<Value> Load(Shard& shard, const Key& key, std::promise<SharedPointer<Value>>& promise)
+    {
+        SharedPointer<Value> value;
+        try
+        {
+            UniquePointer<Value> loaded = loader_(key);
+            if (loaded)
+            {
+                value = SharedPointer<Value>(UniquePointer<Value, Evictor>(loaded.release(), Evictor{this, key}));
+            }
+        }
+        catch (...)
+        {
+            {
+                std::unique_lock write(shard.mutex);
+                shard.loads.erase(key);
+            }
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+
+        {
+            std::unique_lock write(shard.mutex);
+            if (value)
+            {
+                shard.entries.insert_or_assign(key, Entry{WeakPointer<Value>(value), value.get()});
+            }
+            shard.loads.erase(key);
+        }
+        promise.set_value(value);
+        return value;
+    }
+
+    void Evict(const Key& key, const Value* value)
+    {
+        Shard& shard = ShardFor(key);
+        std::unique_lock write(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end() && it->second.object == value)
+        {
+            shard.entries.erase(it);
+        }
+    }
+
+    Loader loader_;
+    std::array<Shard, kShards> shards_;
+};
+
+#endif //WEAKVALUECACHE_H